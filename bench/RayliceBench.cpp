@@ -0,0 +1,609 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "stdafx.h"
+
+#include <boost/program_options.hpp>
+
+/*
+	Microbenchmarks for the hot kernels of the renderer. Every kernel runs on a fixed input
+	set generated from a fixed seed, so numbers are comparable between builds. Results are
+	written as JSON, one entry per kernel with nanoseconds per operation and throughput.
+*/
+
+struct BenchmarkResult
+{
+	std::string name;
+	int64_t operations;
+	double seconds;
+};
+
+class Benchmark
+{
+private:
+	double minSeconds;
+	std::string filter;
+	std::vector<BenchmarkResult> results;
+
+public:
+	static volatile float sink;
+
+	Benchmark(double minSeconds, std::string filter) : minSeconds(minSeconds), filter(filter) { }
+
+	/*
+		Repeats "batch", which performs "opsPerBatch" operations, until at least "minSeconds"
+		have passed. One untimed warm-up run comes first. Benchmarks without operations, e.g. 
+		because the scene has no glass, are skipped since they have no per-operation timing.
+	*/
+	void Run(std::string name, int64_t opsPerBatch, std::function<void ()> batch)
+	{
+		if(!filter.empty() && (name.find(filter) == std::string::npos))
+			return;
+
+		if(opsPerBatch <= 0)
+		{
+			std::cerr << "    > " << name << ": skipped, no operations" << std::endl;
+			return;
+		}
+
+		std::chrono::high_resolution_clock timer;
+		BenchmarkResult result;
+
+		batch();
+
+		result.name = name;
+		result.operations = 0;
+		result.seconds = 0;
+
+		auto start = timer.now();
+		do
+		{
+			batch();
+			result.operations += opsPerBatch;
+			result.seconds = std::chrono::duration<double>(timer.now() - start).count();
+		}while(result.seconds < minSeconds);
+
+		std::cerr << "    > " << name << ": " << (result.seconds * 1e9 / result.operations) << " ns/op" << std::endl;
+
+		results.push_back(result);
+	}
+
+	void WriteJSON(std::ostream& out, const SyntheticScene& scene, const RenderSettings& settings) const
+	{
+		out << "{" << std::endl;
+		out << "  \"triangles\": " << scene.GetTriangleCount() << "," << std::endl;
+		out << "  \"photons\": " << settings.photonCount << "," << std::endl;
+		out << "  \"results\": [" << std::endl;
+
+		for(size_t i = 0; i < results.size(); i++)
+		{
+			const auto& r = results[i];
+
+			out << "    { \"name\": \"" << r.name << "\", \"operations\": " << r.operations 
+				<< ", \"seconds\": " << r.seconds
+				<< ", \"ns_per_op\": " << (r.seconds * 1e9 / r.operations)
+				<< ", \"ops_per_second\": " << (r.operations / r.seconds) << " }"
+				<< ((i + 1 < results.size()) ? "," : "") << std::endl;
+		}
+
+		out << "  ]" << std::endl;
+		out << "}" << std::endl;
+	}
+};
+
+volatile float Benchmark::sink = 0;
+
+static std::vector<PathSegment> CreateCoherentRays(const Camera& camera, int resolution)
+{
+	Vector3 nearOrigin, nearXAxis, nearYAxis, farOrigin, farXAxis, farYAxis;
+	std::vector<PathSegment> rays;
+
+	camera.GetRayRaster(nearOrigin, nearXAxis, nearYAxis, farOrigin, farXAxis, farYAxis);
+
+	// scanline order, just like the screen sampling visits pixels of a tile
+	for(int y = 0; y < resolution; y++)
+	{
+		for(int x = 0; x < resolution; x++)
+		{
+			float xn = x / (float)resolution, yn = y / (float)resolution;
+			Vector3 near = nearOrigin + nearXAxis * xn + nearYAxis * yn;
+			Vector3 far = farOrigin + farXAxis * xn + farYAxis * yn;
+			PathSegment segment;
+
+			segment.SetOrigin(near);
+			segment.SetDirection(far - near);
+			segment.SetTriangleAtImpact(nullptr);
+			rays.push_back(segment);
+		}
+	}
+
+	return rays;
+}
+
+static std::vector<PathSegment> CreateIncoherentRays(RandomGenerator& random, int count)
+{
+	std::vector<PathSegment> rays;
+
+	for(int i = 0; i < count; i++)
+	{
+		PathSegment segment;
+		Vector3 origin = Math::GetRandomVectorInUnitCube(random);
+
+		segment.SetOrigin(Vector3(4.9f * origin.x, 5 + 4.9f * origin.y, 4.9f * origin.z));
+		segment.SetDirection(Math::GetRandomVectorInUnitSphere(random));
+		segment.SetTriangleAtImpact(nullptr);
+		rays.push_back(segment);
+	}
+
+	return rays;
+}
+
+/** Rays leaving the impacts of "hits" in random directions, like hemisphere samples they start on a triangle. */
+static std::vector<PathSegment> CreateSurfaceRays(RandomGenerator& random, const std::vector<PathSegment>& hits)
+{
+	std::vector<PathSegment> rays;
+
+	for(const auto& hit : hits)
+	{
+		PathSegment segment;
+
+		segment.SetOrigin(hit.GetImpact());
+		segment.SetDirection(Math::GetRandomVectorInUnitSphere(random));
+		segment.SetTriangleAtOrigin(hit.GetTriangleAtImpact());
+		rays.push_back(segment);
+	}
+
+	return rays;
+}
+
+/** Does "result" have the impact of casting "ray" on its own? */
+static bool MatchesCastRay(ThreadContext& ctx, const PathSegment& ray, const PathSegment& result)
+{
+	// CastRay() ignores the triangle its incoming segment hit, which is the one "ray" starts on
+	PathSegment incoming;
+	PathSegment single = ray;
+
+	incoming.SetTriangleAtImpact(ray.GetTriangleAtOrigin());
+
+	if(!ctx.CastRay(incoming, single, ERayKind::Primary))
+		single.SetTriangleAtImpact(nullptr);
+
+	if(single.GetTriangleAtImpact() != result.GetTriangleAtImpact())
+		return false;
+
+	return !single.HasImpact() || (Math::Length(single.GetImpact() - result.GetImpact()) <= 1e-4f * (1 + Math::Length(single.GetImpact())));
+}
+
+/*
+	Packets of "packetSize" rays cast with ThreadContext::CastRays() have to find the same
+	impacts as casting each ray on its own. Sizes above the intersector's internal chunk
+	(16 rays) cover the 48 MSAA samples of the "ultra" preset.
+*/
+static bool VerifyCastRays(ThreadContext& ctx, const std::vector<PathSegment>& rays, int packetSize)
+{
+	int mismatches = 0;
+
+	for(size_t offset = 0; offset < rays.size(); offset += packetSize)
+	{
+		std::vector<PathSegment> packet(rays.begin() + offset, rays.begin() + std::min(offset + packetSize, rays.size()));
+
+		ctx.CastRays(packet.data(), (int)packet.size(), ERayKind::Primary);
+
+		for(size_t i = 0; i < packet.size(); i++)
+		{
+			if(!MatchesCastRay(ctx, rays[offset + i], packet[i]))
+				mismatches++;
+		}
+	}
+
+	if(mismatches > 0)
+		std::cerr << "[ERROR]: " << mismatches << " of " << rays.size() << " rays cast in packets of " << packetSize << " differ from single rays." << std::endl;
+
+	return mismatches == 0;
+}
+
+/** Same as VerifyCastRays() for ThreadContext::CastRayStream(), which reorders the rays before casting them. */
+static bool VerifyCastRayStream(ThreadContext& ctx, const std::vector<PathSegment>& rays)
+{
+	std::vector<PathSegment> stream(rays);
+	int mismatches = 0;
+
+	ctx.CastRayStream(stream.data(), (int)stream.size(), ERayKind::Primary);
+
+	for(size_t i = 0; i < rays.size(); i++)
+	{
+		if(!MatchesCastRay(ctx, rays[i], stream[i]))
+			mismatches++;
+	}
+
+	if(mismatches > 0)
+		std::cerr << "[ERROR]: " << mismatches << " of " << rays.size() << " rays cast as one stream differ from single rays." << std::endl;
+
+	return mismatches == 0;
+}
+
+static std::vector<float> GetSortedDistances(const PhotonMapSearch& search, Vector3 where)
+{
+	std::vector<float> distances;
+
+	for(auto photon : search)
+	{
+		distances.push_back(Math::LengthSqr(photon->GetImpact() - where));
+	}
+
+	std::sort(distances.begin(), distances.end());
+	return distances;
+}
+
+/*
+	Batched kNN queries through ThreadContext::SamplePhotons() have to find the same photons
+	as nanoflann's single query search (up to ties on the farthest distance), and compare
+	against exactly as many photons.
+*/
+static bool VerifySampleBatch(ThreadContext& ctx, PhotonMap& map, const std::vector<Vector3>& points, int sampleCount)
+{
+	const int BATCH = 64;
+	PhotonMapSearch single;
+	int mismatches = 0;
+
+	for(size_t first = 0; first < points.size(); first += BATCH)
+	{
+		const int count = (int)std::min<size_t>(BATCH, points.size() - first);
+
+		ctx.SamplePhotons(map, points.data() + first, count, sampleCount);
+
+		for(int i = 0; i < count; i++)
+		{
+			const PhotonMapSearch& batched = ctx.batchSamples[i];
+
+			map.SampleUnbatched(points[first + i], sampleCount, single);
+
+			std::vector<PathSegment*> expected(single.begin(), single.end()), found(batched.begin(), batched.end());
+			std::sort(expected.begin(), expected.end());
+			std::sort(found.begin(), found.end());
+
+			bool isMatch = (batched.GetVisitedCount() == single.GetVisitedCount()) && (found.size() == expected.size());
+
+			if(isMatch && (found != expected))
+			{
+				const auto expectedDistances = GetSortedDistances(single, points[first + i]);
+				const auto foundDistances = GetSortedDistances(batched, points[first + i]);
+
+				for(size_t j = 0; j < found.size(); j++)
+				{
+					isMatch &= std::abs(foundDistances[j] - expectedDistances[j]) <= 1e-5f * expectedDistances[j];
+				}
+			}
+
+			if(!isMatch)
+				mismatches++;
+		}
+	}
+
+	if(mismatches > 0)
+		std::cerr << "[ERROR]: " << mismatches << " of " << points.size() << " batched photon queries for " << sampleCount << " photons differ from single queries." << std::endl;
+
+	return mismatches == 0;
+}
+
+int main(int argc, char** argv)
+{
+	namespace po = boost::program_options;
+
+	po::options_description desc("The following parameters are supported:");
+	desc.add_options()
+		("help", "Show a list of supported parameters.")
+		("min-time", po::value<double>()->default_value(0.5), "Minimum time in seconds spent per kernel.")
+		("filter", po::value<std::string>()->default_value(""), "Only run kernels whose name contains this string.")
+		("triangles", po::value<int>()->default_value(100000), "Number of clutter triangles added to the synthetic scene.")
+		("photon-count,p", po::value<int>()->default_value(200000), "Number of photons in the benchmarked photon map.")
+		("seed", po::value<int>()->default_value(1), "Seed for scene and input generation.")
+		("output-file,o", po::value<std::string>(), "JSON file to write, default is standard output.")
+	;
+
+	po::variables_map vm;
+
+	try
+	{
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);    
+	}
+	catch(...)
+	{
+		std::cout << desc << "\n";
+		return 1;
+	}
+
+	if (vm.count("help")) 
+	{
+		std::cout << desc << "\n";
+		return 1;
+	}
+
+	const int RAY_COUNT = 1 << 16;
+	const uint32_t seed = (uint32_t)vm["seed"].as<int>();
+
+	// setup scene and tracer
+	SyntheticSceneOptions options;
+	options.clutterTriangles = vm["triangles"].as<int>();
+	options.seed = seed;
+
+	auto scene = std::make_shared<SyntheticScene>(options);
+
+	RenderSettings settings("draft");
+	settings.inputFile = "synthetic";
+	settings.photonCount = vm["photon-count"].as<int>();
+	settings.noPreview = true;
+	settings.noBvhCache = true;
+	settings.MakeValid();
+
+	RayTracer tracer(scene, settings);
+	ThreadContext& ctx = tracer.GetThreadContext(0);
+	RandomGenerator random(seed);
+	Benchmark bench(vm["min-time"].as<double>(), vm["filter"].as<std::string>());
+
+	std::cerr << "Tracing photons..." << std::endl;
+	tracer.TracePhotons();
+	tracer.GetIndirectMap().Build(tracer.GetTaskPool());
+
+	std::cerr << "Running benchmarks:" << std::endl;
+
+	// ray casting
+	auto coherentRays = CreateCoherentRays(tracer.GetCamera(), 256);
+	auto incoherentRays = CreateIncoherentRays(random, RAY_COUNT);
+	std::vector<PathSegment> hits;
+
+	for(auto& ray : incoherentRays)
+	{
+		PathSegment hit = ray;
+		if(ctx.CastRay(ray, hit, ERayKind::Primary))
+			hits.push_back(hit);
+	}
+
+	// kernels are only worth timing if they compute the right thing
+	auto surfaceRays = CreateSurfaceRays(random, hits);
+
+	if(!VerifyCastRays(ctx, coherentRays, 48) || !VerifyCastRays(ctx, incoherentRays, 48) || 
+		!VerifyCastRayStream(ctx, incoherentRays) || !VerifyCastRayStream(ctx, surfaceRays))
+		return 1;
+
+	for(auto rays : { &coherentRays, &incoherentRays })
+	{
+		bench.Run((rays == &coherentRays) ? "CastRay.Coherent" : "CastRay.Incoherent", rays->size(), [&]()
+		{
+			PathSegment hit;
+			int hitCount = 0;
+
+			for(auto& ray : *rays)
+			{
+				hit = ray;
+				hitCount += ctx.CastRay(ray, hit, ERayKind::Primary) ? 1 : 0;
+			}
+
+			Benchmark::sink += (float)hitCount;
+		});
+	}
+
+	// 48 is the MSAA sample count of the "ultra" preset, which spans several intersector chunks
+	for(size_t packetSize : { 16, 48 })
+	{
+		bench.Run("CastRays.Coherent." + std::to_string(packetSize), coherentRays.size(), [&]()
+		{
+			std::vector<PathSegment> packet;
+			int hitCount = 0;
+
+			for(size_t offset = 0; offset < coherentRays.size(); offset += packetSize)
+			{
+				packet.assign(coherentRays.begin() + offset, coherentRays.begin() + std::min(offset + packetSize, coherentRays.size()));
+				hitCount += ctx.CastRays(packet.data(), (int)packet.size(), ERayKind::Primary);
+			}
+
+			Benchmark::sink += (float)hitCount;
+		});
+	}
+
+	// photon maps
+	bench.Run("PhotonMap.Build", tracer.GetIndirectMap().GetRegisteredPhotonCount(), [&]()
+	{
+		tracer.GetIndirectMap().Build(tracer.GetTaskPool());
+	});
+
+	for(int k : { 1, 4, 16, 64 })
+	{
+		bench.Run("PhotonMap.Sample.k" + std::to_string(k), hits.size(), [&]()
+		{
+			for(auto& hit : hits)
+			{
+				tracer.GetIndirectMap().Sample(hit.GetImpact(), k, ctx.samples);
+				Benchmark::sink += (*ctx.samples.begin())->GetImpact().x;
+			}
+		});
+	}
+
+	// camera hits are close to their neighbors, batches of them share the walk through the tree
+	std::vector<Vector3> coherentHits;
+
+	for(auto& ray : coherentRays)
+	{
+		PathSegment hit = ray;
+		if(ctx.CastRay(ray, hit, ERayKind::Primary))
+			coherentHits.push_back(hit.GetImpact());
+	}
+
+	std::vector<Vector3> incoherentHits;
+
+	for(auto& hit : hits) incoherentHits.push_back(hit.GetImpact());
+
+	for(int k : { 1, 16, 64, 256 })
+	{
+		if(!VerifySampleBatch(ctx, tracer.GetIndirectMap(), coherentHits, k) || !VerifySampleBatch(ctx, tracer.GetIndirectMap(), incoherentHits, k))
+			return 1;
+	}
+
+	for(int k : { 1, 16, 64 })
+	{
+		bench.Run("PhotonMap.Sample.Coherent.k" + std::to_string(k), coherentHits.size(), [&]()
+		{
+			for(auto& hit : coherentHits)
+			{
+				tracer.GetIndirectMap().Sample(hit, k, ctx.samples);
+				Benchmark::sink += (*ctx.samples.begin())->GetImpact().x;
+			}
+		});
+
+		bench.Run("PhotonMap.SampleBatch.Coherent.k" + std::to_string(k), coherentHits.size(), [&]()
+		{
+			const int BATCH = 64;
+
+			for(size_t first = 0; first < coherentHits.size(); first += BATCH)
+			{
+				const int count = (int)std::min<size_t>(BATCH, coherentHits.size() - first);
+
+				ctx.SamplePhotons(tracer.GetIndirectMap(), coherentHits.data() + first, count, k);
+				Benchmark::sink += (*ctx.batchSamples[0].begin())->GetImpact().x;
+			}
+		});
+	}
+
+	// the same queries gathered from the hashed grid, afterwards the map is back to its kd-tree
+	tracer.GetIndirectMap().SetLookup(EPhotonLookup::Grid);
+	tracer.GetIndirectMap().Build(tracer.GetTaskPool());
+
+	bench.Run("PhotonMap.Build.Grid", tracer.GetIndirectMap().GetRegisteredPhotonCount(), [&]()
+	{
+		tracer.GetIndirectMap().Build(tracer.GetTaskPool());
+	});
+
+	for(int k : { 1, 4, 16, 64 })
+	{
+		bench.Run("PhotonMap.Sample.Grid.k" + std::to_string(k), hits.size(), [&]()
+		{
+			for(auto& hit : hits)
+			{
+				tracer.GetIndirectMap().Sample(hit.GetImpact(), k, ctx.samples);
+				Benchmark::sink += (*ctx.samples.begin())->GetImpact().x;
+			}
+		});
+	}
+
+	tracer.GetIndirectMap().SetLookup(EPhotonLookup::KDTree);
+	tracer.GetIndirectMap().Build(tracer.GetTaskPool());
+
+	// shading kernels
+	bench.Run("Triangle.GetNormal", hits.size(), [&]()
+	{
+		for(auto& hit : hits)
+			Benchmark::sink += hit.GetTriangleAtImpact()->GetNormal(hit.GetImpact()).x;
+	});
+
+	TextureMap texture(512, 512, 4);
+	{
+		std::vector<unsigned char> bytes(512 * 512 * 4);
+		for(auto& b : bytes) b = (unsigned char)random.NextInt(256);
+		texture.SetBytesRGBA(bytes);
+	}
+
+	bench.Run("TextureMap.Interpolated", hits.size(), [&]()
+	{
+		for(auto& hit : hits)
+			Benchmark::sink += texture.Interpolated(*hit.GetTriangleAtImpact(), hit.GetImpact()).r;
+	});
+
+	bench.Run("FresnelTerm", hits.size(), [&]()
+	{
+		for(auto& hit : hits)
+			Benchmark::sink += FresnelTerm(hit, 1.5f).reflectWeight;
+	});
+
+	std::vector<PathSegment> glassHits;
+	for(auto& hit : hits)
+	{
+		if(hit.GetMaterialAtImpact()->HasCausticBsdfs())
+			glassHits.push_back(hit);
+	}
+
+	bench.Run("BSDFMaterial.SelectBSDF", glassHits.size(), [&]()
+	{
+		for(auto& hit : glassHits)
+			Benchmark::sink += (float)(size_t)hit.GetMaterialAtImpact()->SelectBSDF(ctx, hit);
+	});
+
+	// sampling functions
+	const Vector3 normal = Math::Normalized(Vector3(0.3f, 1, 0.2f));
+
+	bench.Run("Math.GetRandomVectorInUnitSphere", RAY_COUNT, [&]()
+	{
+		for(int i = 0; i < RAY_COUNT; i++)
+			Benchmark::sink += Math::GetRandomVectorInUnitSphere(random).x;
+	});
+
+	bench.Run("Math.GetRandomVectorInUnitDisc", RAY_COUNT, [&]()
+	{
+		for(int i = 0; i < RAY_COUNT; i++)
+			Benchmark::sink += Math::GetRandomVectorInUnitDisc(random).x;
+	});
+
+	bench.Run("Math.GetRandomVectorInUnitHalfSphere", RAY_COUNT, [&]()
+	{
+		for(int i = 0; i < RAY_COUNT; i++)
+			Benchmark::sink += Math::GetRandomVectorInUnitHalfSphere(random, normal).x;
+	});
+
+	bench.Run("Math.GetRandomVectorInSolidAngle", RAY_COUNT, [&]()
+	{
+		for(int i = 0; i < RAY_COUNT; i++)
+			Benchmark::sink += Math::GetRandomVectorInSolidAngle(random, normal, 0.3f).x;
+	});
+
+	bench.Run("Math.MapToUnitHalfSphere", RAY_COUNT, [&]()
+	{
+		float uv[2];
+		for(int i = 0; i < RAY_COUNT; i++)
+		{
+			random.NextFloats(uv, 2);
+			Benchmark::sink += Math::MapToUnitHalfSphere(normal, uv[0], uv[1]).x;
+		}
+	});
+
+	for(auto name : { "sobol", "halton", "random" })
+	{
+		auto sampler = Sampler::Create(name);
+
+		bench.Run(std::string("Sampler.") + name + ".Get2D", RAY_COUNT, [&]()
+		{
+			float uv[2];
+			sampler->StartPixel(0);
+			for(int i = 0; i < RAY_COUNT; i++)
+			{
+				sampler->Get2D(ESampleDimension::Hemisphere, uv);
+				Benchmark::sink += uv[0];
+			}
+		});
+	}
+
+	// report
+	if(vm.count("output-file"))
+	{
+		std::ofstream file(vm["output-file"].as<std::string>(), std::ios_base::trunc);
+		bench.WriteJSON(file, *scene, settings);
+	}
+	else
+	{
+		bench.WriteJSON(std::cout, *scene, settings);
+	}
+
+	return 0;
+}
@@ -39,6 +39,26 @@ namespace embree
     VirtualFree(ptr,bytes,MEM_RELEASE);
   }
 
+  const void* os_map_file(const char* fileName, size_t& bytes) 
+  {
+    HANDLE file = CreateFileA(fileName,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_ATTRIBUTE_NORMAL,NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file,&size) || size.QuadPart == 0) { CloseHandle(file); return NULL; }
+    HANDLE mapping = CreateFileMappingA(file,NULL,PAGE_READONLY,0,0,NULL);
+    CloseHandle(file);
+    if (mapping == NULL) return NULL;
+    void* ptr = MapViewOfFile(mapping,FILE_MAP_READ,0,0,0);
+    CloseHandle(mapping); // the view keeps the mapping alive
+    if (ptr == NULL) return NULL;
+    bytes = (size_t)size.QuadPart;
+    return ptr;
+  }
+
+  void os_unmap_file(const void* ptr, size_t bytes) {
+    UnmapViewOfFile(ptr);
+  }
+
   double getSeconds() {
     LARGE_INTEGER freq, val;
     QueryPerformanceFrequency(&freq);
@@ -56,6 +76,9 @@ namespace embree
 
 #include <sys/time.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace embree
 {
@@ -71,6 +94,23 @@ namespace embree
     munmap(ptr,bytes);
   }
 
+  const void* os_map_file(const char* fileName, size_t& bytes) 
+  {
+    int file = open(fileName,O_RDONLY);
+    if (file < 0) return NULL;
+    struct stat info;
+    if (fstat(file,&info) != 0 || info.st_size == 0) { close(file); return NULL; }
+    void* ptr = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file); // the mapping keeps the file alive
+    if (ptr == MAP_FAILED) return NULL;
+    bytes = (size_t)info.st_size;
+    return ptr;
+  }
+
+  void os_unmap_file(const void* ptr, size_t bytes) {
+    munmap((void*)ptr,bytes);
+  }
+
   double getSeconds() {
     struct timeval tp; gettimeofday(&tp,NULL);
     return double(tp.tv_sec) + double(tp.tv_usec)/1E6;
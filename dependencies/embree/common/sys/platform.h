@@ -243,6 +243,12 @@ namespace embree
   void* os_malloc(size_t bytes);
   void os_free(void* ptr, size_t bytes);
 
+  /*! maps a whole file read-only into memory, returns NULL if it
+   *  cannot be opened or is empty. Pages are shared with the page
+   *  cache and only read from disk when first touched. */
+  const void* os_map_file(const char* fileName, size_t& bytes);
+  void os_unmap_file(const void* ptr, size_t bytes);
+
   /*! returns performance counter in seconds */
   double getSeconds();
 }
@@ -35,7 +35,7 @@ namespace embree
     {
       ThreadInfo () : id(0) {}
       ThreadInfo (size_t id) : id(id) {}
-      size_t id;  // thread ID from 0 to getNumberOfLogicalThreads()-1
+      size_t id;  // thread ID from 0 to max(getNumberOfLogicalThreads(),getNumThreads())-1
     };
     
     /*! the run function executed for each work item of the task */
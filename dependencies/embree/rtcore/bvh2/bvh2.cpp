@@ -277,6 +277,13 @@ namespace embree
     }
   }
 
+  size_t BVH2::bytes()
+  {
+    numNodes = numLeaves = numPrimBlocks = numPrims = depth = 0;
+    bvhSAH = statistics(root,0.0f,depth);
+    return numNodes*sizeof(Node) + numPrimBlocks*trity.bytes + numVertices*sizeof(Vec3f);
+  }
+
   void BVH2::print(std::ostream& cout)
   {
     /* calculate statistics */
@@ -114,6 +114,9 @@ namespace embree
     /*! Print statistics of the BVH. */
     void print(std::ostream& cout);
 
+    /*! Memory used by nodes, triangle blocks and vertices in bytes. */
+    size_t bytes();
+
     /*! Rotates tree to improve SAH cost. */
     size_t rotate(Base* node, size_t depth);
     
@@ -20,7 +20,7 @@
 namespace embree
 {
   template<typename TriangleIntersector>
-  void BVH2Intersector<TriangleIntersector>::intersect(const Ray& ray, const std::vector<int>& forbidden, Hit& hit) const
+  void BVH2Intersector<TriangleIntersector>::intersect(const Ray& ray, Hit& hit) const
   {
     AVX_ZERO_UPPER();
     STAT3(normal.travs,1,1,1);
@@ -91,7 +91,7 @@ namespace embree
         STAT3(shadow.trav_leaves,1,1,1);
         size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
         for (size_t i=0; i<num; i++)
-          TriangleIntersector::intersect(ray,hit,tri[i],bvh->vertices,forbidden);
+          TriangleIntersector::intersect(ray,hit,tri[i],bvh->vertices);
         nearFar = shuffle<0,1,2,3>(nearFar,-hit.t);
       }
 
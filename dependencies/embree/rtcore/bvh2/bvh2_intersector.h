@@ -33,7 +33,7 @@ namespace embree
 
   public:
     BVH2Intersector (const Ref<BVH2 >& bvh) : bvh(bvh) {}
-    void intersect(const Ray& ray, const std::vector<int>& forbidden, Hit& hit) const;
+    void intersect(const Ray& ray, Hit& hit) const;
     bool occluded (const Ray& ray) const;
 
   private:
@@ -108,6 +108,9 @@ namespace embree
     /*! Print statistics of the BVH. */
     void print(std::ostream& cout);
 
+    /*! Memory used by nodes, triangle blocks and vertices in bytes. */
+    size_t bytes();
+
     /*! Rotates tree to improve SAH cost. */
     size_t rotate(Base* node, size_t depth);
 
@@ -126,6 +129,7 @@ namespace embree
     const Vec3fa* vertices;            //!< Pointer to vertex array.
     size_t numVertices;                //!< Number of vertices
     bool freeVertices;                 //!< Should we delete the vertex array?
+    Ref<RefCount> storage;             //!< Keeps nodes and triangles stored outside of alloc alive.
 
   private:
     float statistics(Base* node, float area, size_t& depth);
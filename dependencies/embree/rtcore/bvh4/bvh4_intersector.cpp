@@ -21,7 +21,7 @@
 namespace embree
 {
   template<typename TriangleIntersector>
-  void BVH4Intersector<TriangleIntersector>::intersect(const Ray& ray, const std::vector<int>& forbidden, Hit& hit) const
+  void BVH4Intersector<TriangleIntersector>::intersect(const Ray& ray, Hit& hit) const
   {
     AVX_ZERO_UPPER();
     STAT3(normal.travs,1,1,1);
@@ -130,7 +130,7 @@ namespace embree
         STAT3(normal.trav_leaves,1,1,1);
         size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
         for (size_t i=0; i<num; i++)
-          TriangleIntersector::intersect(ray,hit,tri[i],bvh->vertices,forbidden);
+          TriangleIntersector::intersect(ray,hit,tri[i],bvh->vertices);
 
         popCur = (BVH4::Base*) stackPtr[-1].ptr;    //!< pre-pop of topmost stack item
         popDist = stackPtr[-1].dist;                //!< pre-pop of distance of topmost stack item
@@ -220,6 +220,152 @@ namespace embree
     return false;
   }
 
+  /*! Stack entry of the packet traverser, remembers which rays of the packet hit the node. */
+  struct PacketStackItem
+  {
+    BVH4::Base* ptr;
+    float dist;
+    size_t mask;
+  };
+
+  /*! Traverses the BVH once for up to "N" rays, with "vfloat" holding
+   *  one component of all rays. Nodes are visited if any ray of the
+   *  packet hits them, leaves are only intersected with the rays that
+   *  hit the leaf's bounding box. */
+  template<typename TriangleIntersector, typename vfloat, size_t N>
+  static void intersectPacketN(const BVH4* bvh, const Ray* rays, Hit* hits, size_t count)
+  {
+    typedef typename TriangleIntersector::Triangle Triangle;
+
+    /*! load the rays into SIMD registers, unused lanes get an empty segment */
+    float orgX[N], orgY[N], orgZ[N], rdirX[N], rdirY[N], rdirZ[N], nearT[N], farT[N];
+
+    for (size_t i=0; i<N; i++)
+    {
+      const Ray& ray = rays[min(i,count-1)];
+      orgX[i] = ray.org.x; orgY[i] = ray.org.y; orgZ[i] = ray.org.z;
+      rdirX[i] = ray.rdir.x; rdirY[i] = ray.rdir.y; rdirZ[i] = ray.rdir.z;
+
+      if (i < count) {
+        hits[i].t = min(hits[i].t,ray.far);
+        nearT[i] = ray.near;
+        farT[i] = hits[i].t;
+      } else {
+        nearT[i] = pos_inf;
+        farT[i] = neg_inf;
+      }
+    }
+
+    const vfloat orgx(orgX), orgy(orgY), orgz(orgZ);
+    const vfloat rdirx(rdirX), rdiry(rdirY), rdirz(rdirZ);
+    const vfloat rayNear(nearT);
+    vfloat rayFar(farT);
+
+    /*! stack state */
+    PacketStackItem stack[1+3*BVH4::maxDepth];
+    PacketStackItem* stackPtr = stack;
+    stackPtr->ptr = bvh->root; stackPtr->dist = neg_inf; stackPtr->mask = (size_t(1) << count)-1; stackPtr++;
+
+    while (stackPtr != stack)
+    {
+      /*! pop next node, skip it if all rays found a closer hit meanwhile */
+      stackPtr--;
+      BVH4::Base* cur = stackPtr->ptr;
+      size_t curMask = stackPtr->mask;
+      float maxFar = neg_inf;
+
+      for (size_t i=0; i<count; i++) maxFar = max(maxFar,farT[i]);
+      if (stackPtr->dist > maxFar) continue;
+
+      while (cur->isNode())
+      {
+        /*! all rays against the 4 boxes, one box at a time */
+        const BVH4::Node* node = cur->node();
+        PacketStackItem children[4];
+        size_t numChildren = 0;
+
+        for (size_t c=0; c<4; c++)
+        {
+          /*! empty children have inverted bounds, which only the single ray code rejects implicitly */
+          if (node->child[c] == (BVH4::Base*)BVH4::Base::empty)
+            continue;
+
+          const vfloat tx0 = (vfloat(node->lower_x[c]) - orgx) * rdirx, tx1 = (vfloat(node->upper_x[c]) - orgx) * rdirx;
+          const vfloat ty0 = (vfloat(node->lower_y[c]) - orgy) * rdiry, ty1 = (vfloat(node->upper_y[c]) - orgy) * rdiry;
+          const vfloat tz0 = (vfloat(node->lower_z[c]) - orgz) * rdirz, tz1 = (vfloat(node->upper_z[c]) - orgz) * rdirz;
+          const vfloat tNear = max(max(min(tx0,tx1),min(ty0,ty1)),max(min(tz0,tz1),rayNear));
+          const vfloat tFar = min(min(max(tx0,tx1),max(ty0,ty1)),min(max(tz0,tz1),rayFar));
+          const size_t mask = movemask(tNear <= tFar) & curMask;
+
+          if (mask == 0)
+            continue;
+
+          PacketStackItem& child = children[numChildren++];
+          child.ptr = node->child[c];
+          child.mask = mask;
+          child.dist = pos_inf;
+
+          for (size_t m=mask; m!=0; m=__btc(m,__bsf(m)))
+            child.dist = min(child.dist,tNear[__bsf(m)]);
+        }
+
+        if (numChildren == 0) {
+          cur = NULL;
+          break;
+        }
+
+        /*! push all but the closest child, farthest first */
+        for (size_t i=1; i<numChildren; i++)
+          for (size_t j=i; j>0 && children[j-1].dist < children[j].dist; j--)
+            std::swap(children[j-1],children[j]);
+
+        for (size_t i=0; i<numChildren-1; i++)
+          *stackPtr++ = children[i];
+
+        cur = children[numChildren-1].ptr;
+        curMask = children[numChildren-1].mask;
+      }
+
+      if (cur == NULL)
+        continue;
+
+      /*! this is a leaf node, intersect the rays that reached it */
+      size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
+
+      for (size_t m=curMask; m!=0; m=__btc(m,__bsf(m)))
+      {
+        const size_t r = __bsf(m);
+
+        for (size_t i=0; i<num; i++)
+          TriangleIntersector::intersect(rays[r],hits[r],tri[i],bvh->vertices);
+
+        farT[r] = hits[r].t;
+      }
+
+      rayFar = vfloat(farT);
+    }
+  }
+
+  template<typename TriangleIntersector>
+  void BVH4Intersector<TriangleIntersector>::intersectPacket(const Ray* rays, Hit* hits, size_t count) const
+  {
+    AVX_ZERO_UPPER();
+
+    for (size_t i=0; i<count; ) 
+    {
+#if defined(__AVX__)
+      const size_t n = min(count-i,size_t(8));
+      intersectPacketN<TriangleIntersector,avxf,8>(bvh.ptr,rays+i,hits+i,n);
+#else
+      const size_t n = min(count-i,size_t(4));
+      intersectPacketN<TriangleIntersector,ssef,4>(bvh.ptr,rays+i,hits+i,n);
+#endif
+      i += n;
+    }
+
+    AVX_ZERO_UPPER();
+  }
+
   /* explicit template instantiation */
   INSTANTIATE_TEMPLATE_BY_INTERSECTOR(BVH4Intersector);
 }
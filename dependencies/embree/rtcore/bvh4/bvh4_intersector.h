@@ -33,9 +33,12 @@ namespace embree
     
   public:
     BVH4Intersector (const Ref<BVH4>& bvh) : bvh(bvh) {}
-    void intersect(const Ray& ray, const std::vector<int>& forbidden, Hit& hit) const;
+    void intersect(const Ray& ray, Hit& hit) const;
     bool occluded (const Ray& ray) const;
 
+    /*! Packet traversal, 8 rays per packet with AVX and 4 otherwise. */
+    void intersectPacket(const Ray* rays, Hit* hits, size_t count) const;
+
   private:
     Ref<BVH4> bvh;
   };
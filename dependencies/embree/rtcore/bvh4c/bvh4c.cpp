@@ -0,0 +1,186 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4c.h"
+#include "bvh4c_intersector.h"
+#include "../triangle/triangle4i.h"
+
+#include <unordered_map>
+
+namespace embree
+{
+  /*! Hash of a vertex position, used to merge vertices shared by several triangles. */
+  struct VertexHash
+  {
+    __forceinline size_t operator()(const Vec3f& v) const {
+      const unsigned int* bits = (const unsigned int*)&v;
+      return size_t(bits[0])*73856093 ^ size_t(bits[1])*19349663 ^ size_t(bits[2])*83492791;
+    }
+  };
+
+  struct VertexEqual
+  {
+    __forceinline bool operator()(const Vec3f& a, const Vec3f& b) const {
+      return a.x == b.x && a.y == b.y && a.z == b.z;
+    }
+  };
+
+  /*! Quantizes [lower,upper] conservatively to steps of "scale" starting at "start". */
+  static __forceinline void quantize(float start, float scale, float lower, float upper, unsigned char& qlower, unsigned char& qupper)
+  {
+    const float rcpScale = scale > 0.0f ? 1.0f/scale : 0.0f;
+    int lo = clamp(int(floorf((lower-start)*rcpScale)),0,255);
+    int hi = clamp(int(ceilf ((upper-start)*rcpScale)),0,255);
+
+    /* the dequantized bounds have to enclose the child despite rounding */
+    while (lo > 0   && start+float(lo)*scale > lower) lo--;
+    while (hi < 255 && start+float(hi)*scale < upper) hi++;
+
+    qlower = (unsigned char)lo;
+    qupper = (unsigned char)hi;
+  }
+
+  BVH4C::BVH4C (const std::string& intTy) 
+    : Accel(intTy), root(empty), nodes(NULL), numNodes(0), triangles(NULL), numTriangles(0), vertices(NULL), numVertices(0) {}
+
+  void BVH4C::compress(const BVH4* bvh, const Vec3fa* vertices, size_t numVertices)
+  {
+    /* merge vertices with identical positions, the first occurrence is the canonical one */
+    std::vector<int> canonical(numVertices);
+    {
+      std::unordered_map<Vec3f,int,VertexHash,VertexEqual> first;
+      for (size_t i=0; i<numVertices; i++)
+        canonical[i] = first.insert(std::make_pair(Vec3f(vertices[i]),int(i))).first->second;
+    }
+
+    /* pool entries are created in traversal order of the leaves */
+    std::vector<int> remap(numVertices,-1);
+    root = compress(bvh->root,vertices,canonical,remap);
+
+    nodes = nodeArray.empty() ? NULL : &nodeArray[0]; numNodes = nodeArray.size();
+    triangles = triangleArray.empty() ? NULL : &triangleArray[0]; numTriangles = triangleArray.size();
+    this->vertices = vertexArray.empty() ? NULL : &vertexArray[0]; this->numVertices = vertexArray.size();
+  }
+
+  BVH4C::NodeRef BVH4C::compress(BVH4::Base* node, const Vec3fa* inputVertices, const std::vector<int>& canonical, std::vector<int>& remap)
+  {
+    if (node->isLeaf())
+    {
+      size_t blocks; const Triangle4i* tri = (const Triangle4i*) node->leaf(blocks);
+      const size_t first = triangleArray.size();
+
+      for (size_t i=0; i<blocks; i++) 
+      {
+        for (size_t j=0; j<tri[i].size(); j++)
+        {
+          const int v[3] = { canonical[tri[i].v0[j]], canonical[tri[i].v1[j]], canonical[tri[i].v2[j]] };
+          unsigned int idx[3];
+          for (size_t k=0; k<3; k++) {
+            if (remap[v[k]] < 0) {
+              const Vertex vertex = { inputVertices[v[k]].x, inputVertices[v[k]].y, inputVertices[v[k]].z };
+              remap[v[k]] = int(vertexArray.size());
+              vertexArray.push_back(vertex);
+            }
+            idx[k] = remap[v[k]];
+          }
+          Triangle t; t.v0 = idx[0]; t.v1 = idx[1]; t.v2 = idx[2]; t.id0 = tri[i].id0[j];
+          triangleArray.push_back(t);
+        }
+      }
+
+      const size_t num = triangleArray.size()-first;
+      if (num == 0) return empty;
+      if (num > maxLeafTris) throw std::runtime_error("bvh4c: too many triangles in leaf");
+      if (triangleArray.size() > maxTris) throw std::runtime_error("bvh4c: too many triangles");
+      return encodeLeaf(first,num);
+    }
+
+    /* bounds of this node are the merged bounds of its children */
+    const BVH4::Node* src = node->node();
+    BBox3f bounds = embree::empty;
+    for (size_t i=0; i<4; i++) 
+      if (src->child[i] != (BVH4::Base*)BVH4::Base::empty) bounds = merge(bounds,src->get(i));
+
+    /* 254 steps leave room to round the upper bounds up */
+    const size_t index = nodeArray.size();
+    nodeArray.push_back(Node());
+    Node& dst = nodeArray[index];
+    const Vec3f scale = (bounds.upper-bounds.lower)*(1.0f/254.0f);
+    dst.start.x = bounds.lower.x; dst.start.y = bounds.lower.y; dst.start.z = bounds.lower.z;
+    dst.scale.x = scale.x; dst.scale.y = scale.y; dst.scale.z = scale.z;
+
+    for (size_t i=0; i<4; i++) 
+    {
+      if (src->child[i] == (BVH4::Base*)BVH4::Base::empty) {
+        dst.lower_x[i] = dst.lower_y[i] = dst.lower_z[i] = 255;
+        dst.upper_x[i] = dst.upper_y[i] = dst.upper_z[i] = 0;
+        continue;
+      }
+      const BBox3f b = src->get(i);
+      quantize(dst.start.x,dst.scale.x,b.lower.x,b.upper.x,dst.lower_x[i],dst.upper_x[i]);
+      quantize(dst.start.y,dst.scale.y,b.lower.y,b.upper.y,dst.lower_y[i],dst.upper_y[i]);
+      quantize(dst.start.z,dst.scale.z,b.lower.z,b.upper.z,dst.lower_z[i],dst.upper_z[i]);
+    }
+
+    /* recursion may reallocate the node array */
+    for (size_t i=0; i<4; i++) {
+      const NodeRef child = src->child[i] == (BVH4::Base*)BVH4::Base::empty ? empty : compress(src->child[i],inputVertices,canonical,remap);
+      nodeArray[index].child[i] = child;
+    }
+    return NodeRef(index);
+  }
+
+  Ref<RefCount> BVH4C::query(const char* name) 
+  {
+    if (!strcmp(name,Intersector::name)) {
+      if (intTy == "default" ) return new BVH4CIntersector(this);
+      if (intTy == "fast"    ) return new BVH4CIntersector(this);
+      if (intTy == "moeller" ) return new BVH4CIntersector(this);
+      throw std::runtime_error("unknown triangle intersector \""+intTy+"\" for bvh4c");
+    }
+    throw std::runtime_error("unknown triangle intersector interface \""+std::string(name)+"\"");
+  }
+
+  size_t BVH4C::bytes() 
+  {
+    return numNodes*sizeof(Node) + numTriangles*sizeof(Triangle) + numVertices*sizeof(Vertex);
+  }
+
+  void BVH4C::print(std::ostream& cout)
+  {
+    std::ios::fmtflags flags = std::cout.flags();
+    size_t bytesNodes = numNodes*sizeof(Node);
+    size_t bytesTris  = numTriangles*sizeof(Triangle);
+    size_t bytesVertices = numVertices*sizeof(Vertex);
+    size_t bytesTotal = bytesNodes+bytesTris+bytesVertices;
+    cout.setf(std::ios::fixed, std::ios::floatfield);
+    cout.precision(1);
+    cout << "size = " << bytesTotal/1E6 << " MB" << std::endl;
+    cout << "nodes = " << numNodes << " "
+         << "(" << bytesNodes/1E6 << " MB) "
+         << "(" << 100.0*double(bytesNodes)/double(bytesTotal) << "% of total)" 
+         << std::endl;
+    cout << "triangles = " << numTriangles << " "
+         << "(" << bytesTris/1E6 << " MB) "
+         << "(" << 100.0*double(bytesTris)/double(bytesTotal) << "% of total)" 
+         << std::endl;
+    cout << "vertices = " << numVertices << " "
+         << "(" << bytesVertices/1E6 << " MB) "
+         << "(" << 100.0*double(bytesVertices)/double(bytesTotal) << "% of total)" 
+         << std::endl;
+    std::cout.flags(flags);
+  }
+}
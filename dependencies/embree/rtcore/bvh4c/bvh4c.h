@@ -0,0 +1,123 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_BVH4C_H__
+#define __EMBREE_BVH4C_H__
+
+#include "../common/accel.h"
+#include "../bvh4/bvh4.h"
+
+namespace embree
+{
+  /*! Compressed BVH with 4 children. Child bounds are quantized to 8
+   *  bits relative to the bounds of their parent, child references are
+   *  32 bit indices and triangles are 32 bit indices into a shared pool
+   *  of deduplicated vertices. A node takes 64 bytes instead of the 128
+   *  bytes of a BVH4 node. */
+  class BVH4C : public Accel
+  {
+  public:
+
+    /*! Reference to a node or a leaf. Leaves have the topmost bit set,
+     *  store the number of triangles in the next 5 bits and the index of
+     *  the first triangle in the remaining 26 bits. */
+    typedef unsigned int NodeRef;
+
+    static const NodeRef leafFlag = 0x80000000;
+    static const size_t leafShift = 26;
+    static const size_t maxLeafTris = 31;
+    static const size_t maxTris = size_t(1) << leafShift;
+
+    /*! Empty leaf, its quantized bounds are inverted so no ray ever hits it. */
+    static const NodeRef empty = leafFlag;
+
+    /*! Maximal depth of the BVH. */
+    static const size_t maxDepth = BVH4::maxDepth;
+
+    __forceinline static bool isLeaf(NodeRef ref) { return (ref & leafFlag) != 0; }
+    __forceinline static size_t leafFirst(NodeRef ref) { return ref & ((1 << leafShift)-1); }
+    __forceinline static size_t leafCount(NodeRef ref) { return (ref & ~leafFlag) >> leafShift; }
+    __forceinline static NodeRef encodeLeaf(size_t first, size_t num) { return leafFlag | NodeRef(num << leafShift) | NodeRef(first); }
+
+    /*! Unpadded vertex, Vec3f is 16 bytes with SSE. */
+    struct Vertex
+    {
+      float x, y, z;
+
+      __forceinline operator Vec3f() const { return Vec3f(x,y,z); }
+    };
+
+    /*! BVH4C Node */
+    struct Node
+    {
+      /*! Dequantized lower bound along one axis is start+lower*scale. */
+      Vertex start;                  //!< Lower corner of the node bounds.
+      Vertex scale;                  //!< Size of one quantization step per axis.
+      unsigned char lower_x[4];      //!< X dimension of lower bounds of all 4 children.
+      unsigned char upper_x[4];      //!< X dimension of upper bounds of all 4 children.
+      unsigned char lower_y[4];      //!< Y dimension of lower bounds of all 4 children.
+      unsigned char upper_y[4];      //!< Y dimension of upper bounds of all 4 children.
+      unsigned char lower_z[4];      //!< Z dimension of lower bounds of all 4 children.
+      unsigned char upper_z[4];      //!< Z dimension of upper bounds of all 4 children.
+      NodeRef child[4];              //!< The 4 children (can be a node or leaf)
+    };
+
+    /*! Triangle of an indexed face set. */
+    struct Triangle
+    {
+      unsigned int v0, v1, v2;       //!< Indices into the vertex pool.
+      int id0;                       //!< 1st user ID, the 2nd one is not stored.
+    };
+
+  public:
+
+    /*! BVH4C default constructor. */
+    BVH4C (const std::string& intTy);
+
+    /*! Compresses "bvh", which has to store triangle4i leaves over "vertices". */
+    void compress(const BVH4* bvh, const Vec3fa* vertices, size_t numVertices);
+
+    /*! Query interface to the acceleration structure. */
+    Ref<RefCount> query(const char* name);
+
+    /*! Print statistics of the BVH. */
+    void print(std::ostream& cout);
+
+    /*! Memory used by nodes, triangles and vertices in bytes. */
+    size_t bytes();
+
+  private:
+    NodeRef compress(BVH4::Base* node, const Vec3fa* vertices, const std::vector<int>& canonical, std::vector<int>& remap);
+    
+    /*! Data of the BVH, points into the arrays below or into a mapped file. */
+  public:
+    NodeRef root;                      //!< Root node (can also be a leaf).
+    const Node* nodes;                 //!< All inner nodes.
+    size_t numNodes;                   //!< Number of inner nodes.
+    const Triangle* triangles;         //!< Triangles referenced by the leaves.
+    size_t numTriangles;               //!< Number of triangles.
+    const Vertex* vertices;            //!< Deduplicated vertex pool.
+    size_t numVertices;                //!< Number of vertices.
+    Ref<RefCount> storage;             //!< Keeps externally stored data alive.
+
+  private:
+    std::vector<Node> nodeArray;         //!< Nodes of a BVH compressed in memory.
+    std::vector<Triangle> triangleArray; //!< Triangles of a BVH compressed in memory.
+    std::vector<Vertex> vertexArray;     //!< Vertices of a BVH compressed in memory.
+  };
+}
+
+#endif
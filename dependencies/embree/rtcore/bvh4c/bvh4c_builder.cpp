@@ -0,0 +1,41 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4c_builder.h"
+#include "../bvh4/bvh4_builder.h"
+#include "../common/heuristics.h"
+#include "../triangle/triangles.h"
+
+namespace embree
+{
+  BVH4CBuilder::BVH4CBuilder(const TriangleType& trity, const std::string& intTy,
+                             const BuildTriangle* triangles, size_t numTriangles, 
+                             const Vec3fa* vertices, size_t numVertices, const BBox3f& bounds, bool freeData)
+    : bvh(new BVH4C(intTy))
+  {
+    if (numTriangles > BVH4C::maxTris) 
+      throw std::runtime_error("bvh4c: too many triangles");
+
+    {
+      Ref<BVH4> uncompressed = BVH4Builder<HeuristicBinning<Triangle4i::logBlockSize> >(Triangle4i::type,"default",triangles,numTriangles,vertices,numVertices,bounds,false).bvh;
+      bvh->compress(uncompressed.ptr,vertices,numVertices);
+    }
+
+    /* the vertices got copied into the pool, and the blocks of the uncompressed BVH are unused now */
+    if (freeData) alignedFree(vertices);
+    Alloc::global.clear();
+  }
+}
@@ -0,0 +1,43 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_BVH4C_BUILDER_H__
+#define __EMBREE_BVH4C_BUILDER_H__
+
+#include "bvh4c.h"
+
+namespace embree
+{
+  /* BVH4C builder. Runs the multi-threaded BVH4 builder over indexed
+   * triangles and compresses the result, the uncompressed BVH is only
+   * alive during the build. */
+  class BVH4CBuilder : public RefCount
+  {
+  public:
+
+    /*! Type of BVH build */
+    typedef BVH4C Type;
+
+    /*! Constructor. */
+    BVH4CBuilder(const TriangleType& trity, const std::string& intTy, 
+                 const BuildTriangle* triangles, size_t numTriangles, const Vec3fa* vertices, size_t numVertices, const BBox3f& bounds, bool freeData);
+
+  public:
+    Ref<BVH4C> bvh;                      //!< Output BVH
+  };
+}
+
+#endif
@@ -0,0 +1,220 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "bvh4c_intersector.h"
+#include "../common/stack_item.h"
+
+namespace embree
+{
+  /*! Converts 4 quantized bounds to floats. */
+  static __forceinline ssef dequantize(const unsigned char* q) 
+  {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bytes = _mm_cvtsi32_si128(*(const int*)q);
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(bytes,zero),zero));
+  }
+
+  /*! Moeller Trumbore test of up to 4 triangles of the vertex pool, see Triangle4iIntersectorMoellerTrumbore. */
+  template<bool occlusion>
+  static __forceinline bool intersectTriangles(const Ray& ray, Hit& hit, const BVH4C::Triangle* tri, size_t num, const BVH4C::Vertex* vertices)
+  {
+    /* gather vertices, unused lanes repeat the first triangle and get masked out */
+    sse3f p0, p1, p2; ssei id0;
+    for (size_t i=0; i<4; i++) 
+    {
+      const BVH4C::Triangle& t = tri[i < num ? i : 0];
+      const BVH4C::Vertex& a = vertices[t.v0], &b = vertices[t.v1], &c = vertices[t.v2];
+      p0.x[i] = a.x; p0.y[i] = a.y; p0.z[i] = a.z;
+      p1.x[i] = b.x; p1.y[i] = b.y; p1.z[i] = b.z;
+      p2.x[i] = c.x; p2.y[i] = c.y; p2.z[i] = c.z;
+      id0[i] = t.id0;
+    }
+
+    /* calculate edges and geometry normal */
+    const sse3f e1 = p0-p1;
+    const sse3f e2 = p2-p0;
+    const sse3f Ng = cross(e1,e2);
+    const sse3f O = sse3f(ray.org);
+    const sse3f D = sse3f(ray.dir);
+
+    /* calculate determinant */
+    const sse3f C = p0 - O;
+    const sse3f R = cross(D,C);
+    const ssef det = dot(Ng,D);
+    const ssef absDet = abs(det);
+    const ssef sgnDet = signmsk(det);
+
+    /* perform edge tests */
+    const ssef U = dot(R,e2) ^ sgnDet;
+    const ssef V = dot(R,e1) ^ sgnDet;
+    const ssef W = absDet-U-V;
+    sseb valid = (ssei(step) < ssei(int(num))) & (U >= 0.0f) & (V >= 0.0f) & (W >= 0.0f);
+    if (unlikely(none(valid))) return false;
+
+    /* perform depth test */
+    const ssef T = dot(Ng,C) ^ sgnDet;
+    valid &= (det != ssef(zero)) & (T >= absDet*ssef(ray.near)) & (absDet*ssef(occlusion ? ray.far : hit.t) >= T) & (id0 != ssei(ray.excludeId));
+    if (unlikely(none(valid))) return false;
+    if (occlusion) return true;
+
+    /* update hit information */
+    const ssef rcpAbsDet = rcp(absDet);
+    const ssef u = U * rcpAbsDet;
+    const ssef v = V * rcpAbsDet;
+    const ssef t = T * rcpAbsDet;
+    const size_t i = select_min(valid,t);
+    hit.t = t[i];
+    hit.u = u[i];
+    hit.v = v[i];
+    hit.id0 = id0[i];
+    hit.id1 = 0;
+    return true;
+  }
+
+  /*! Intersects the ray with the 4 dequantized child boxes of "node". */
+  static __forceinline size_t intersectBoxes(const BVH4C::Node* node, const Ray& ray, const size_t near[3], const ssef& rayNear, const ssef& rayFar, ssef& tNear)
+  {
+    const unsigned char* q = node->lower_x;
+    const ssef startX(node->start.x-ray.org.x), startY(node->start.y-ray.org.y), startZ(node->start.z-ray.org.z);
+    const ssef scaleX(node->scale.x), scaleY(node->scale.y), scaleZ(node->scale.z);
+    const ssef rdirX(ray.rdir.x), rdirY(ray.rdir.y), rdirZ(ray.rdir.z);
+
+    const ssef tNearX = (startX + dequantize(q+near[0]) * scaleX) * rdirX;
+    const ssef tNearY = (startY + dequantize(q+near[1]) * scaleY) * rdirY;
+    const ssef tNearZ = (startZ + dequantize(q+near[2]) * scaleZ) * rdirZ;
+    const ssef tFarX  = (startX + dequantize(q+(near[0]^4)) * scaleX) * rdirX;
+    const ssef tFarY  = (startY + dequantize(q+(near[1]^4)) * scaleY) * rdirY;
+    const ssef tFarZ  = (startZ + dequantize(q+(near[2]^4)) * scaleZ) * rdirZ;
+
+    tNear = max(tNearX,tNearY,tNearZ,rayNear);
+    const ssef tFar = min(tFarX,tFarY,tFarZ,rayFar);
+    return movemask(tNear <= tFar);
+  }
+
+  void BVH4CIntersector::intersect(const Ray& ray, Hit& hit) const
+  {
+    STAT3(normal.travs,1,1,1);
+
+    /*! stack state */
+    StackItem stack[1+3*BVH4C::maxDepth];  //!< stack of nodes that still need to get traversed
+    StackItem* stackPtr = stack;           //!< current stack pointer
+    stackPtr->ptr = (void*)size_t(bvh->root); stackPtr->dist = neg_inf; stackPtr++;
+
+    /*! offsets to select the quantized side that becomes the lower or upper bound */
+    const size_t near[3] = { 
+      ray.dir.x >= 0 ? 0 : 4, 
+      ray.dir.y >= 0 ? 8 : 12, 
+      ray.dir.z >= 0 ? 16 : 20 
+    };
+
+    const BVH4C::Vertex* vertices = bvh->vertices;
+    const BVH4C::Triangle* triangles = bvh->triangles;
+    const ssef rayNear(ray.near);
+    hit.t = min(hit.t,ray.far);
+
+    while (stackPtr != stack)
+    {
+      /*! pop next node, skip it if it is farther away than the closest hit */
+      stackPtr--;
+      if (unlikely(stackPtr->dist > hit.t)) continue;
+      NodeRef cur = NodeRef(size_t(stackPtr->ptr));
+
+      /*! descend into the closest child, push the others sorted by distance */
+      while (!BVH4C::isLeaf(cur))
+      {
+        STAT3(normal.trav_nodes,1,1,1);
+        const Node* node = &bvh->nodes[cur];
+        ssef tNear;
+        size_t _hit = intersectBoxes(node,ray,near,rayNear,ssef(hit.t),tNear);
+
+        if (unlikely(_hit == 0)) { cur = BVH4C::empty; break; }
+
+        StackItem* first = stackPtr;
+        while (_hit) {
+          const size_t r = __bsf(_hit); _hit = __btc(_hit,r);
+          stackPtr->ptr = (void*)size_t(node->child[r]); stackPtr->dist = tNear[r]; stackPtr++;
+        }
+
+        /*! closest child ends up on top of the stack */
+        const size_t num = stackPtr-first;
+        if      (num == 2) { if (first[0].dist < first[1].dist) swap(first[0],first[1]); }
+        else if (num == 3) sort(first[2],first[1],first[0]);
+        else if (num == 4) sort(first[3],first[2],first[1],first[0]);
+
+        stackPtr--;
+        cur = NodeRef(size_t(stackPtr->ptr));
+      }
+
+      /*! this is a leaf node */
+      STAT3(normal.trav_leaves,1,1,1);
+      const size_t first = BVH4C::leafFirst(cur), num = BVH4C::leafCount(cur);
+      for (size_t i=0; i<num; i+=4) {
+        STAT3(normal.trav_tris,1,1,1);
+        intersectTriangles<false>(ray,hit,triangles+first+i,min(num-i,size_t(4)),vertices);
+      }
+    }
+  }
+
+  bool BVH4CIntersector::occluded(const Ray& ray) const
+  {
+    STAT3(shadow.travs,1,1,1);
+
+    /*! stack state */
+    NodeRef stack[1+3*BVH4C::maxDepth];  //!< stack of nodes that still need to get traversed
+    NodeRef* stackPtr = stack+1;         //!< current stack pointer
+    stack[0] = bvh->root;                //!< push first node onto stack
+
+    /*! offsets to select the quantized side that becomes the lower or upper bound */
+    const size_t near[3] = { 
+      ray.dir.x >= 0 ? 0 : 4, 
+      ray.dir.y >= 0 ? 8 : 12, 
+      ray.dir.z >= 0 ? 16 : 20 
+    };
+
+    const BVH4C::Vertex* vertices = bvh->vertices;
+    const BVH4C::Triangle* triangles = bvh->triangles;
+    const ssef rayNear(ray.near), rayFar(ray.far);
+    Hit hit;
+
+    while (stackPtr != stack)
+    {
+      const NodeRef cur = *--stackPtr;
+
+      if (likely(!BVH4C::isLeaf(cur)))
+      {
+        STAT3(shadow.trav_nodes,1,1,1);
+        const Node* node = &bvh->nodes[cur];
+        ssef tNear;
+        size_t _hit = intersectBoxes(node,ray,near,rayNear,rayFar,tNear);
+
+        while (_hit) {
+          const size_t r = __bsf(_hit); _hit = __btc(_hit,r);
+          *stackPtr++ = node->child[r];
+        }
+        continue;
+      }
+
+      /*! this is a leaf node */
+      STAT3(shadow.trav_leaves,1,1,1);
+      const size_t first = BVH4C::leafFirst(cur), num = BVH4C::leafCount(cur);
+      for (size_t i=0; i<num; i+=4) {
+        STAT3(shadow.trav_tris,1,1,1);
+        if (intersectTriangles<true>(ray,hit,triangles+first+i,min(num-i,size_t(4)),vertices)) return true;
+      }
+    }
+    return false;
+  }
+}
@@ -0,0 +1,42 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#ifndef __EMBREE_BVH4C_INTERSECTOR_H__
+#define __EMBREE_BVH4C_INTERSECTOR_H__
+
+#include "bvh4c.h"
+#include "../common/intersector.h"
+
+namespace embree
+{
+  /*! BVH4C Traverser. Single ray traversal implementation for the
+   *  compressed Quad BVH, child bounds are dequantized on the fly. */
+  class BVH4CIntersector : public Intersector
+  {
+    typedef BVH4C::NodeRef NodeRef;
+    typedef BVH4C::Node Node;
+    
+  public:
+    BVH4CIntersector (const Ref<BVH4C>& bvh) : bvh(bvh) {}
+    void intersect(const Ray& ray, Hit& hit) const;
+    bool occluded (const Ray& ray) const;
+
+  private:
+    Ref<BVH4C> bvh;
+  };
+}
+
+#endif
@@ -21,7 +21,7 @@
 namespace embree
 {
   template<typename TriangleIntersector>
-  void BVH4MBIntersector<TriangleIntersector>::intersect(const Ray& ray, const std::vector<int>& forbidden, Hit& hit) const
+  void BVH4MBIntersector<TriangleIntersector>::intersect(const Ray& ray, Hit& hit) const
   {
     AVX_ZERO_UPPER();
     STAT3(normal.travs,1,1,1);
@@ -136,7 +136,7 @@ namespace embree
         STAT3(normal.trav_leaves,1,1,1);
         size_t num; Triangle* tri = (Triangle*) cur->leaf(num);
         for (size_t i=0; i<num; i++)
-          TriangleIntersector::intersect(ray,hit,tri[i],bvh->vertices,forbidden);
+          TriangleIntersector::intersect(ray,hit,tri[i],bvh->vertices);
 
         popCur = (Base*) stackPtr[-1].ptr;  //!< pre-pop of topmost stack item
         popDist = stackPtr[-1].dist;        //!< pre-pop of distance of topmost stack item
@@ -26,6 +26,10 @@
 #include "bvh4/bvh4.h"
 #include "bvh4/bvh4_builder.h"
 
+/* include BVH4C */
+#include "bvh4c/bvh4c.h"
+#include "bvh4c/bvh4c_builder.h"
+
 /* include BVH4MB */
 #include "bvh4mb/bvh4mb.h"
 #include "bvh4mb/bvh4mb_builder.h"
@@ -247,6 +251,17 @@ namespace embree
       }
     }
 
+    /* compressed BVH4 with object split builder, always stores indexed triangles */
+    if (accelTy == "bvh4c") 
+    {
+      if (triTy == "default")
+        return build<BVH4CBuilder>(Triangle4i::type,intTy,triangles,numTriangles,vertices,numVertices,bounds,freeData);
+      else {
+        throw std::runtime_error("invalid triangle type for bvh4c: "+std::string(triTy));
+        return null;
+      }
+    }
+
     /* BVH4MB with object split builder */
     if (accelTy == "bvh4mb.objectsplit" || accelTy == "bvh4mb") 
     {
@@ -72,6 +72,9 @@ namespace embree
       return dynamic_cast<Interface*>(query(Interface::name).ptr);
     }
 
+    /*! Memory used by nodes, triangle blocks and vertices in bytes. */
+    virtual size_t bytes() = 0;
+
   private:
 
     /*! Query interface to the acceleration structure. */
@@ -95,6 +98,29 @@ namespace embree
                             size_t numVertices,              //!< number of vertices in array
                             const BBox3f& bounds = empty,    //!< optional approximate bounding box of the geometry
                             bool freeArrays = true);         //!< if true, triangle and vertex arrays are freed when no longer needed
+
+  /*! Writes an acceleration structure returned by rtcCreateAccel to a
+   *  file. The key identifies the geometry it was built over, accelTy
+   *  and triTy have to be the strings passed to rtcCreateAccel. Only
+   *  bvh4 and bvh4c structures are supported, returns false for other
+   *  structures or if the file cannot be written. */
+  bool rtcSaveAccel(const Ref<Accel>& accel,                 //!< acceleration structure to store
+                    const char* accelTy,                     //!< type of acceleration structure it was created with
+                    const char* triTy,                       //!< type of triangle representation it was created with
+                    uint64 key,                              //!< identifies the geometry, e.g. a hash of the builder input
+                    const char* fileName);                   //!< file to write, replaced if it exists
+
+  /*! Loads an acceleration structure written by rtcSaveAccel instead
+   *  of building it. The file is mapped read-only: bvh4c structures and
+   *  bvh4 vertex arrays are used in place, the bvh4 tree holds child
+   *  pointers and is read into memory to relocate them. Returns null
+   *  if the file does not
+   *  exist or was written for a different key, accelTy, triTy or by an
+   *  incompatible build of embree. */
+  Ref<Accel> rtcLoadAccel(const char* fileName,              //!< file written by rtcSaveAccel
+                          const char* accelTy,               //!< type of acceleration structure to use
+                          const char* triTy,                 //!< type of triangle representation to use
+                          uint64 key);                       //!< has to match the key passed to rtcSaveAccel
 }
 
 #endif
@@ -0,0 +1,322 @@
+// ======================================================================== //
+// Copyright 2009-2012 Intel Corporation                                    //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "accel.h"
+#include "bvh4/bvh4.h"
+#include "bvh4c/bvh4c.h"
+#include "triangle/triangles.h"
+
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <cstdio>
+
+#if defined(__WIN32__)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace embree
+{
+  /*! Layout version, has to be incremented whenever a stored structure changes. */
+  static const unsigned int accelFileVersion = 1;
+
+  /*! Stored acceleration structures. */
+  enum { ACCEL_FILE_BVH4 = 0, ACCEL_FILE_BVH4C = 1 };
+
+  /*! Header at the start of an accel file. Section offsets are
+   *  relative to the start of the file and aligned to 64 bytes. For
+   *  bvh4 section 0 holds nodes and triangle blocks with child
+   *  references relative to the section start, for bvh4c sections 0,
+   *  1 and 2 hold the node, triangle and vertex arrays. Section 2
+   *  holds the vertex array of bvh4 if its triangles need one. */
+  struct AccelFileHeader
+  {
+    char magic[8];              //!< "embracc"
+    unsigned int version;       //!< accelFileVersion of the writer
+    unsigned int kind;          //!< stored acceleration structure
+    uint64 key;                 //!< geometry key passed by the application
+    uint64 fileBytes;           //!< size of the file, detects truncated files
+    unsigned int pointerBytes;  //!< pointer size of the writer
+    unsigned int nodeBytes;     //!< node size of the writer
+    char accelTy[32];           //!< accelTy passed to rtcCreateAccel
+    char triTy[32];             //!< triTy passed to rtcCreateAccel
+    char trity[32];             //!< name of the stored triangle type
+    uint64 root;                //!< root reference
+    uint64 offset[3];           //!< offset of each section
+    uint64 count[3];            //!< number of elements (bytes for the bvh4 tree) per section
+  };
+
+  /*! Read-only mapped accel file, unmapped when the last structure referencing it is destroyed. */
+  class MappedAccelFile : public RefCount
+  {
+  public:
+    MappedAccelFile (const char* ptr, size_t bytes) : ptr(ptr), bytes(bytes) {}
+    ~MappedAccelFile () { os_unmap_file(ptr,bytes); }
+  public:
+    const char* ptr;
+    size_t bytes;
+  };
+
+  /*! In-memory copy of a bvh4 tree loaded from an accel file. Keeps
+   *  the file mapped as well, since the vertex array is used in place. */
+  class LoadedAccelTree : public RefCount
+  {
+  public:
+    LoadedAccelTree (const Ref<MappedAccelFile>& file, const char* tree, size_t bytes) 
+      : file(file), ptr((char*)alignedMalloc(bytes,64)) { memcpy(ptr,tree,bytes); }
+    ~LoadedAccelTree () { alignedFree(ptr); }
+  public:
+    Ref<MappedAccelFile> file;
+    char* ptr;
+  };
+
+  /*! Sequential writer that aligns sections and keeps track of their offsets. */
+  class AccelFileWriter
+  {
+  public:
+    AccelFileWriter (const std::string& fileName) : file(fileName.c_str(),std::ios::binary|std::ios::trunc), pos(0) {}
+
+    /*! Pads the file to a multiple of "align" and returns the new offset. */
+    uint64 align(size_t align) {
+      static const char zeros[64] = { 0 };
+      const size_t pad = (align - pos % align) % align;
+      file.write(zeros,pad); pos += pad;
+      return pos;
+    }
+
+    /*! Writes "bytes" at an offset aligned to "align" and returns that offset. */
+    uint64 write(const void* data, size_t bytes, size_t align = 64) {
+      const uint64 offset = this->align(align);
+      file.write((const char*)data,bytes); pos += bytes;
+      return offset;
+    }
+
+  public:
+    std::ofstream file;
+    uint64 pos;
+  };
+
+  static bool storeString(char* dst, const char* src, size_t size) 
+  {
+    if (strlen(src) >= size) return false;
+    memset(dst,0,size); strcpy(dst,src);
+    return true;
+  }
+
+  static bool equalString(const char* stored, const char* src, size_t size) {
+    return strnlen(stored,size) < size && !strcmp(stored,src);
+  }
+
+  static const TriangleType* triangleType(const char* name) 
+  {
+    const TriangleType* types[] = { &Triangle1i::type, &Triangle4i::type, &Triangle1v::type, &Triangle4v::type, 
+                                    &Triangle1::type, &Triangle4::type, &Triangle8::type };
+    for (size_t i=0; i<sizeof(types)/sizeof(types[0]); i++) 
+      if (types[i]->name == name) return types[i];
+    return NULL;
+  }
+
+  /*! Writes the children before their parent, so the parent can store their final offsets. */
+  static uint64 writeTree(AccelFileWriter& out, uint64 start, const TriangleType& trity, BVH4::Base* node)
+  {
+    if (node->isLeaf()) {
+      size_t num; char* tri = node->leaf(num);
+      if (num == 0) return BVH4::Base::empty;
+      return (out.write(tri,num*trity.bytes,1 << BVH4::alignment)-start) | (num+1);
+    }
+
+    BVH4::Node copy = *node->node();
+    for (size_t i=0; i<4; i++) 
+      copy.child[i] = (BVH4::Base*)(size_t)writeTree(out,start,trity,copy.child[i]);
+    return out.write(&copy,sizeof(BVH4::Node),1 << BVH4::alignment)-start;
+  }
+
+  /*! Turns the stored child references of an in-memory copy of the tree into pointers, returns false for references outside of the tree. */
+  static bool relocateTree(char* base, size_t bytes, const TriangleType& trity, BVH4::Base*& node, size_t depth)
+  {
+    const size_t ref = (size_t)node;
+    if (ref == BVH4::Base::empty) return true;
+
+    const size_t offset = ref & ~BVH4::Base::mask, num = ref & BVH4::Base::mask;
+    const size_t size = num ? (num-1)*trity.bytes : sizeof(BVH4::Node);
+    if (depth > BVH4::maxDepth || offset > bytes || size > bytes-offset) return false;
+
+    node = (BVH4::Base*)(base+ref);
+    if (node->isLeaf()) return true;
+
+    BVH4::Node* n = node->node();
+    for (size_t i=0; i<4; i++)
+      if (!relocateTree(base,bytes,trity,n->child[i],depth+1)) return false;
+    return true;
+  }
+
+  /*! Validates the references of a bvh4c tree once on load, so
+   *  traversal never leaves the arrays. Every inner node may be
+   *  reached only once, which also bounds the walk for corrupt files. */
+  static bool validateTree(const BVH4C& bvh, BVH4C::NodeRef ref, size_t depth, size_t& numVisited)
+  {
+    if (BVH4C::isLeaf(ref)) {
+      const size_t first = BVH4C::leafFirst(ref), num = BVH4C::leafCount(ref);
+      return first <= bvh.numTriangles && num <= bvh.numTriangles-first;
+    }
+
+    if (depth > BVH4C::maxDepth || ref >= bvh.numNodes || ++numVisited > bvh.numNodes) return false;
+    for (size_t i=0; i<4; i++)
+      if (!validateTree(bvh,bvh.nodes[ref].child[i],depth+1,numVisited)) return false;
+    return true;
+  }
+
+  /*! Temporary file next to "fileName" that no other process writing the same file uses. */
+  static std::string tempFileName(const char* fileName)
+  {
+    std::random_device random;
+    std::ostringstream name;
+    name << fileName << "." << getpid() << "." << std::hex << random() << ".tmp";
+    return name.str();
+  }
+
+  bool rtcSaveAccel(const Ref<Accel>& accel, const char* accelTy, const char* triTy, uint64 key, const char* fileName)
+  {
+    AccelFileHeader header;
+    memset(&header,0,sizeof(header));
+    strcpy(header.magic,"embracc");
+    header.version = accelFileVersion;
+    header.key = key;
+    header.pointerBytes = sizeof(void*);
+    if (!storeString(header.accelTy,accelTy,sizeof(header.accelTy))) return false;
+    if (!storeString(header.triTy,triTy,sizeof(header.triTy))) return false;
+
+    BVH4* bvh4 = dynamic_cast<BVH4*>(accel.ptr);
+    BVH4C* bvh4c = dynamic_cast<BVH4C*>(accel.ptr);
+    if (!bvh4 && !bvh4c) return false;
+    if (bvh4 && !storeString(header.trity,bvh4->trity.name.c_str(),sizeof(header.trity))) return false;
+
+    /* write to a temporary file first, a concurrent reader never sees a partial file */
+    const std::string tempName = tempFileName(fileName);
+    {
+      AccelFileWriter out(tempName);
+      out.write(&header,sizeof(header));
+
+      if (bvh4) 
+      {
+        header.kind = ACCEL_FILE_BVH4;
+        header.nodeBytes = sizeof(BVH4::Node);
+        if (bvh4->vertices) {
+          header.offset[2] = out.write(bvh4->vertices,bvh4->numVertices*sizeof(Vec3fa));
+          header.count[2] = bvh4->numVertices;
+        }
+        header.offset[0] = out.align(64);
+        header.root = writeTree(out,header.offset[0],bvh4->trity,bvh4->root);
+        header.count[0] = out.pos-header.offset[0];
+      }
+      else 
+      {
+        header.kind = ACCEL_FILE_BVH4C;
+        header.nodeBytes = sizeof(BVH4C::Node);
+        header.root = bvh4c->root;
+        header.offset[0] = out.write(bvh4c->nodes,bvh4c->numNodes*sizeof(BVH4C::Node));
+        header.offset[1] = out.write(bvh4c->triangles,bvh4c->numTriangles*sizeof(BVH4C::Triangle));
+        header.offset[2] = out.write(bvh4c->vertices,bvh4c->numVertices*sizeof(BVH4C::Vertex));
+        header.count[0] = bvh4c->numNodes;
+        header.count[1] = bvh4c->numTriangles;
+        header.count[2] = bvh4c->numVertices;
+      }
+
+      header.fileBytes = out.pos;
+      out.file.seekp(0);
+      out.file.write((const char*)&header,sizeof(header));
+      out.file.close();
+      if (out.file.fail()) { std::remove(tempName.c_str()); return false; }
+    }
+
+    std::remove(fileName);
+    if (std::rename(tempName.c_str(),fileName) != 0) { std::remove(tempName.c_str()); return false; }
+    return true;
+  }
+
+  Ref<Accel> rtcLoadAccel(const char* fileName, const char* accelTy, const char* triTy, uint64 key)
+  {
+    size_t bytes = 0;
+    const char* ptr = (const char*) os_map_file(fileName,bytes);
+    if (ptr == NULL) return null;
+    Ref<MappedAccelFile> file = new MappedAccelFile(ptr,bytes);
+
+    /* validate header */
+    if (bytes < sizeof(AccelFileHeader)) return null;
+    const AccelFileHeader& header = *(const AccelFileHeader*)ptr;
+    if (strcmp(header.magic,"embracc") || header.version != accelFileVersion) return null;
+    if (header.key != key || header.fileBytes != bytes || header.pointerBytes != sizeof(void*)) return null;
+    if (!equalString(header.accelTy,accelTy,sizeof(header.accelTy))) return null;
+    if (!equalString(header.triTy,triTy,sizeof(header.triTy))) return null;
+
+    /* intersector type follows the triangle type, as for rtcCreateAccel */
+    std::string intTy = "default";
+    const char* dot = strchr(triTy,'.');
+    if (dot) intTy = dot+1;
+
+    if (header.kind == ACCEL_FILE_BVH4)
+    {
+      const TriangleType* trity = strnlen(header.trity,sizeof(header.trity)) < sizeof(header.trity) ? triangleType(header.trity) : NULL;
+      if (!trity || header.nodeBytes != sizeof(BVH4::Node)) return null;
+      if (header.offset[0] > bytes || header.count[0] > bytes-header.offset[0]) return null;
+      if (header.offset[2] > bytes || header.count[2] > (bytes-header.offset[2])/sizeof(Vec3fa)) return null;
+      if (trity->needVertices && header.count[2] == 0) return null;
+
+      /* child pointers have to be rewritten, which would touch every
+       * page of a mapping anyway, so the tree is read into memory */
+      Ref<LoadedAccelTree> tree = new LoadedAccelTree(file,ptr+header.offset[0],size_t(header.count[0]));
+      const Vec3fa* vertices = header.count[2] ? (const Vec3fa*)(ptr+header.offset[2]) : NULL;
+      Ref<BVH4> bvh = new BVH4(*trity,intTy,vertices,size_t(header.count[2]),false);
+      BVH4::Base* root = (BVH4::Base*)(size_t)header.root;
+      if (!relocateTree(tree->ptr,size_t(header.count[0]),*trity,root,0)) return null;
+      bvh->root = root;
+      bvh->storage = tree.ptr;
+      return bvh.ptr;
+    }
+
+    if (header.kind == ACCEL_FILE_BVH4C)
+    {
+      if (header.nodeBytes != sizeof(BVH4C::Node)) return null;
+      const size_t elementBytes[3] = { sizeof(BVH4C::Node), sizeof(BVH4C::Triangle), sizeof(BVH4C::Vertex) };
+      for (size_t i=0; i<3; i++)
+        if (header.offset[i] > bytes || header.count[i] > (bytes-header.offset[i])/elementBytes[i]) return null;
+
+      /* node references are offsets into the arrays, so they are used in place once validated */
+      Ref<BVH4C> bvh = new BVH4C(intTy);
+      bvh->root = BVH4C::NodeRef(header.root);
+      bvh->nodes = (const BVH4C::Node*)(ptr+header.offset[0]);
+      bvh->triangles = (const BVH4C::Triangle*)(ptr+header.offset[1]);
+      bvh->vertices = (const BVH4C::Vertex*)(ptr+header.offset[2]);
+      bvh->numNodes = size_t(header.count[0]);
+      bvh->numTriangles = size_t(header.count[1]);
+      bvh->numVertices = size_t(header.count[2]);
+
+      for (size_t i=0; i<bvh->numTriangles; i++) {
+        const BVH4C::Triangle& tri = bvh->triangles[i];
+        if (tri.v0 >= bvh->numVertices || tri.v1 >= bvh->numVertices || tri.v2 >= bvh->numVertices) return null;
+      }
+      size_t numVisited = 0;
+      if (!validateTree(*bvh,bvh->root,0,numVisited)) return null;
+      bvh->storage = file.ptr;
+      return bvh.ptr;
+    }
+
+    return null;
+  }
+}
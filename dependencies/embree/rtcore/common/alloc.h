@@ -22,6 +22,7 @@
 #include "sys/taskscheduler.h"
 
 #include <vector>
+#include <algorithm>
 
 namespace embree
 {
@@ -118,7 +119,8 @@ namespace embree
 
     /*! Allocator default construction. */
     AllocatorPerThread () {
-      thread = new ThreadAllocator[getNumberOfLogicalThreads()];
+      /* the scheduler may be replaced by one with more threads than cores */
+      thread = new ThreadAllocator[std::max(getNumberOfLogicalThreads(),scheduler->getNumThreads())];
     }
 
     /*! Allocator destructor. */
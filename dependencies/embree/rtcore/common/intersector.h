@@ -38,11 +38,19 @@ namespace embree
     /*! Intersects the ray with the geometry and returns the hit
      *  information. */
     virtual void intersect(const Ray& ray,   /*!< Ray to shoot. */
-						   const std::vector<int>& forbidden, // list of triangles that should be ignored.
                            Hit& hit          /*!< Hit result.   */) const = 0;
 
     /*! Tests the ray for occlusion with the scene. */
     virtual bool occluded (const Ray& ray    /*!< Ray to test occlusion for. */) const = 0;
+
+    /*! Intersects "count" rays, which should be coherent, and returns
+     *  the hit information of each. This default implementation traces
+     *  them one by one, traversers may override it with packet code. */
+    virtual void intersectPacket(const Ray* rays, Hit* hits, size_t count) const
+    {
+      for (size_t i=0; i<count; i++)
+        intersect(rays[i],hits[i]);
+    }
   };
 }
 
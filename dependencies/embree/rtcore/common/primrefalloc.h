@@ -58,7 +58,8 @@ namespace embree
 
     /*! Allocator default construction. */
     PrimRefAlloc () {
-      threadPrimBlockAllocator = new ThreadPrimBlockAllocator[getNumberOfLogicalThreads()];
+      /* the scheduler may be replaced by one with more threads than cores */
+      threadPrimBlockAllocator = new ThreadPrimBlockAllocator[std::max(getNumberOfLogicalThreads(),scheduler->getNumThreads())];
     }
 
     /*! Allocator destructor. */
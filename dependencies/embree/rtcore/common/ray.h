@@ -30,8 +30,8 @@ namespace embree
 
     /*! Constructs a ray from origin, direction, and ray segment. Near
      *  has to be smaller than far. */
-    __forceinline Ray(const Vec3f& org, const Vec3f& dir, float near = zero, float far = inf, float time = zero)
-      : org(org), dir(dir), rdir(rcp_safe(dir)), near(near), far(far), time(time) {}
+    __forceinline Ray(const Vec3f& org, const Vec3f& dir, float near = zero, float far = inf, float time = zero, int excludeId = -1)
+      : org(org), dir(dir), rdir(rcp_safe(dir)), near(near), far(far), time(time), excludeId(excludeId) {}
 
   public:
     Vec3f org;     //!< Ray origin
@@ -40,11 +40,12 @@ namespace embree
     float near;    //!< Start of ray segment
     float far;     //!< End of ray segment
     float time;    //!< Time of this ray for motion blur.
+    int excludeId; //!< Triangle (id0) the ray never hits, usually the one it starts on, -1 for none.
   };
 
   /*! Outputs ray to stream. */
   inline std::ostream& operator<<(std::ostream& cout, const Ray& ray) {
-    return cout << "{ org = " << ray.org << ", dir = " << ray.dir << ", rdir = " << ray.rdir << ", near = " << ray.near << ", far = " << ray.far << ", time = " << ray.time << " }";
+    return cout << "{ org = " << ray.org << ", dir = " << ray.dir << ", rdir = " << ray.rdir << ", near = " << ray.near << ", far = " << ray.far << ", time = " << ray.time << ", excludeId = " << ray.excludeId << " }";
   }
 }
 
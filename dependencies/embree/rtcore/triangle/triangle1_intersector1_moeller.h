@@ -37,9 +37,10 @@ namespace embree
     typedef Triangle1 Triangle;
 
     /*! Intersect a ray with the triangle and updates the hit. */
-    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle1& tri, const Vec3fa* vertices, const std::vector<int>& forbidden)
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle1& tri, const Vec3fa* vertices)
     {
       STAT3(normal.trav_tris,1,1,1);
+      if (unlikely(tri.e1.a == ray.excludeId)) return;
 
       /* calculate determinant */
       const Vec3f O = ray.org;
@@ -77,6 +78,7 @@ namespace embree
     static __forceinline bool occluded(const Ray& ray, const Triangle1& tri, const Vec3fa* vertices = NULL)
     {
       STAT3(shadow.trav_tris,1,1,1);
+      if (unlikely(tri.e1.a == ray.excludeId)) return false;
 
       /* calculate determinant */
       const Vec3f O = Vec3f(ray.org);
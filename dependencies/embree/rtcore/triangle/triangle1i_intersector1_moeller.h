@@ -31,9 +31,10 @@ namespace embree
     typedef Triangle1i Triangle;
 
     /*! Intersect a single ray with a single triangle. */
-    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle1i& tri, const Vec3fa* vertices, const std::vector<int>& forbidden)
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle1i& tri, const Vec3fa* vertices)
     {
       STAT3(normal.trav_tris,1,1,1);
+      if (unlikely(tri.id0 == ray.excludeId)) return;
 
       /* calculate edges and geometry normal */
       const Vec3f p0 = vertices[tri.v0];
@@ -80,6 +81,7 @@ namespace embree
     static __forceinline bool occluded(const Ray& ray, const Triangle1i& tri, const Vec3fa* vertices)
     {
       STAT3(shadow.trav_tris,1,1,1);
+      if (unlikely(tri.id0 == ray.excludeId)) return false;
 
       /* calculate edges and geometry normal */
       const Vec3f p0 = vertices[tri.v0];
@@ -33,9 +33,10 @@ namespace embree
     typedef Triangle1v Triangle;
 
     /*! Intersect a ray with the 4 triangles and updates the hit. */
-    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle1v& tri, const Vec3fa* vertices, const std::vector<int>& forbidden)
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle1v& tri, const Vec3fa* vertices)
     {
       STAT3(normal.trav_tris,1,1,1);
+      if (unlikely(tri.v0.a == ray.excludeId)) return;
 
       /* calculate edges, geometry normal, and determinant */
       const Vec3f O = ray.org;
@@ -78,6 +79,7 @@ namespace embree
     static __forceinline bool occluded(const Ray& ray, const Triangle1v& tri, const Vec3fa* vertices = NULL)
     {
       STAT3(shadow.trav_tris,1,1,1);
+      if (unlikely(tri.v0.a == ray.excludeId)) return false;
 
       /* calculate edges, geometry normal, and determinant */
       const Vec3f O = ray.org;
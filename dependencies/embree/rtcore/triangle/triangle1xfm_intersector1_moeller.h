@@ -33,9 +33,10 @@ namespace embree
     typedef Triangle1Xfm Triangle;
 
     /*! Intersect a ray with the 4 triangles and updates the hit. */
-    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle1Xfm& tri, const Vec3fa* vertices, const std::vector<int>& forbidden)
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle1Xfm& tri, const Vec3fa* vertices)
     {
       STAT3(normal.trav_tris,1,1,1);
+      if (unlikely(tri.id0 == ray.excludeId)) return;
       
       /* transform ray into unit triangle space */
       const Vec3f uorg = xfmPoint (tri.xfm,ray.org);
@@ -66,6 +67,7 @@ namespace embree
     static __forceinline bool occluded(const Ray& ray, const Triangle1Xfm& tri, const Vec3fa* vertices = NULL)
     {
       STAT3(shadow.trav_tris,1,1,1);
+      if (unlikely(tri.id0 == ray.excludeId)) return false;
       
       /* transform ray into unit triangle space */
       const Vec3f uorg = xfmPoint (tri.xfm,ray.org);
@@ -36,7 +36,7 @@ namespace embree
     typedef Triangle4 Triangle;
 
     /*! Intersect a ray with the 4 triangles and updates the hit. */
-    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle4& tri, const Vec3fa* vertices, const std::vector<int>& forbidden)
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle4& tri, const Vec3fa* vertices)
     {
       STAT3(normal.trav_tris,1,1,1);
 
@@ -66,27 +66,9 @@ namespace embree
       const ssef v = V * rcpAbsDet;
       const ssef t = T * rcpAbsDet;
 
-	  for(int j = 0; j < 4; j++)
-	  {
-		  if(!valid[j])
-			  continue;
-
-		  bool isForbidden = t[j] < 0.0001f;
-		  for(int k = 0; k < forbidden.size(); k++)
-		  {
-			if(tri.id0[j] == forbidden[k])
-			{
-				isForbidden = true;
-				break;
-			}
-		  }
-
-		  if(isForbidden)
-			  valid[j] = 0;
-	  }
-
-	  if (unlikely(none(valid))) 
-		  return;
+      /* skip the triangle the ray starts on */
+      valid &= tri.id0 != ssei(ray.excludeId);
+      if (unlikely(none(valid))) return;
 
 	  const size_t i = select_min(valid,t);
 
@@ -120,7 +102,7 @@ namespace embree
       
       /* perform depth test */
       const ssef T = dot(tri.Ng,C) ^ sgnDet;
-      valid &= (det != ssef(zero)) & (T >= absDet*ssef(ray.near)) & (absDet*ssef(ray.far) >= T);
+      valid &= (det != ssef(zero)) & (T >= absDet*ssef(ray.near)) & (absDet*ssef(ray.far) >= T) & (tri.id0 != ssei(ray.excludeId));
       if (unlikely(none(valid))) return false;
 
       return true;
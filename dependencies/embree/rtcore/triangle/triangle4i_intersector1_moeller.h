@@ -31,7 +31,7 @@ namespace embree
     typedef Triangle4i Triangle;
 
     /*! Intersect a ray with the 4 triangles and updates the hit. */
-    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle4i& tri, const Vec3fa* vertices, const std::vector<int>& forbidden)
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle4i& tri, const Vec3fa* vertices)
     {
       STAT3(normal.trav_tris,1,1,1);
 
@@ -64,7 +64,7 @@ namespace embree
       
       /* perform depth test */
       const ssef T = dot(Ng,C) ^ sgnDet;
-      valid &= (det != ssef(zero)) & (T >= absDet*ssef(ray.near)) & (absDet*ssef(hit.t) >= T);
+      valid &= (det != ssef(zero)) & (T >= absDet*ssef(ray.near)) & (absDet*ssef(hit.t) >= T) & ((tri.id0 & 0x7FFFFFFF) != ssei(ray.excludeId));
       if (unlikely(none(valid))) return;
 
       /* update hit information */
@@ -114,7 +114,7 @@ namespace embree
       
       /* perform depth test */
       const ssef T = dot(Ng,C) ^ sgnDet;
-      valid &= (det != ssef(zero)) & (T >= absDet*ssef(ray.near)) & (absDet*ssef(ray.far) >= T);
+      valid &= (det != ssef(zero)) & (T >= absDet*ssef(ray.near)) & (absDet*ssef(ray.far) >= T) & ((tri.id0 & 0x7FFFFFFF) != ssei(ray.excludeId));
       if (unlikely(none(valid))) return false;
 
       return true;
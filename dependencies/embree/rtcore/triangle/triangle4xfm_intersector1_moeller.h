@@ -31,7 +31,7 @@ namespace embree
     typedef Triangle4Xfm Triangle;
 
     /*! Intersect a ray with the 4 triangles and updates the hit. */
-    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle4Xfm& tri, const Vec3fa* vertices, const std::vector<int>& forbidden)
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle4Xfm& tri, const Vec3fa* vertices)
     {
       STAT3(normal.trav_tris,1,1,1);
       const sse3f org = ray.org;
@@ -55,7 +55,7 @@ namespace embree
       
       /* perform depth test */
       const ssef T = -uorgz^sgnudirz;
-      valid &= (udirz != 0.0f) & (T > absudirz*ssef(ray.near)) & (T < absudirz*ssef(hit.t));
+      valid &= (udirz != 0.0f) & (T > absudirz*ssef(ray.near)) & (T < absudirz*ssef(hit.t)) & (tri.id0 != ssei(ray.excludeId));
       if (unlikely(none(valid))) return;
 
       /* update hit information */
@@ -96,7 +96,7 @@ namespace embree
       
       /* perform depth test */
       const ssef T = -uorgz^sgnudirz;
-      valid &= (udirz != 0.0f) & (T > absudirz*ssef(ray.near)) & (T < absudirz*ssef(ray.far));
+      valid &= (udirz != 0.0f) & (T > absudirz*ssef(ray.near)) & (T < absudirz*ssef(ray.far)) & (tri.id0 != ssei(ray.excludeId));
       return any(valid);
     }
   };
@@ -34,7 +34,7 @@ namespace embree
     typedef Triangle8 Triangle;
 
     /*! Intersect a ray with the 4 triangles and updates the hit. */
-    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle8& tri, const Vec3fa* vertices, const std::vector<int>& forbidden)
+    static __forceinline void intersect(const Ray& ray, Hit& hit, const Triangle8& tri, const Vec3fa* vertices)
     {
       STAT3(normal.trav_tris,1,1,1);
 
@@ -65,27 +65,9 @@ namespace embree
       const avxf v = V * rcpAbsDet;
       const avxf t = T * rcpAbsDet;
 
-	  for(int j = 0; j < 8; j++)
-	  {
-		  if(!valid[j])
-			  continue;
-
-		  bool isForbidden = t[j] < 0.0001f;
-		  for(int k = 0; k < forbidden.size(); k++)
-		  {
-			if(tri.id0[j] == forbidden[k])
-			{
-				isForbidden = true;
-				break;
-			}
-		  }
-
-		  if(isForbidden)
-			  valid[j] = 0;
-	  }
-
-	  if (unlikely(none(valid))) 
-		  return;
+      /* skip the triangle the ray starts on */
+      valid &= tri.id0 != avxi(ray.excludeId);
+      if (unlikely(none(valid))) return;
 
       const size_t i = select_min(valid,t);
       hit.u   = u[i];
@@ -118,7 +100,7 @@ namespace embree
       
       /* perform depth test */
       const avxf T = dot(tri.Ng,C) ^ sgnDet;
-      valid &= (det != avxf(zero)) & (T >= absDet*avxf(ray.near)) & (absDet*avxf(ray.far) >= T);
+      valid &= (det != avxf(zero)) & (T >= absDet*avxf(ray.near)) & (absDet*avxf(ray.far) >= T) & (tri.id0 != avxi(ray.excludeId));
       if (unlikely(none(valid))) return false;
 
       return true;
@@ -69,7 +69,10 @@ namespace nanoflann
 		CountType count;
 
 	public:
-		inline KNNResultSet(CountType capacity_) : capacity(capacity_), count(0)
+		/** Number of points compared against the query point during the search. */
+		size_t visited;
+
+		inline KNNResultSet(CountType capacity_) : capacity(capacity_), count(0), visited(0)
 		{
 		}
 
@@ -133,7 +136,10 @@ namespace nanoflann
 
 		std::vector<std::pair<IndexType,DistanceType> >& m_indices_dists;
 
-		inline RadiusResultSet(DistanceType radius_, std::vector<std::pair<IndexType,DistanceType> >& indices_dists) : radius(radius_), m_indices_dists(indices_dists)
+		/** Number of points compared against the query point during the search. */
+		size_t visited;
+
+		inline RadiusResultSet(DistanceType radius_, std::vector<std::pair<IndexType,DistanceType> >& indices_dists) : radius(radius_), m_indices_dists(indices_dists), visited(0)
 		{
 			init();
 		}
@@ -835,7 +841,7 @@ namespace nanoflann
 
 		/** @} */
 
-	private:
+	protected:
 		/** Make sure the auxiliary list \a vind has the same size than the current dataset, and re-generate if size has changed. */
 		void init_vind()
 		{
@@ -1127,7 +1133,7 @@ namespace nanoflann
 		{
 			/* If this is a leaf node, then do check and return. */
 			if ((node->child1 == NULL)&&(node->child2 == NULL)) {
-				//count_leaf += (node->lr.right-node->lr.left);  // Removed since was neither used nor returned to the user.
+				result_set.visited += (node->lr.right-node->lr.left);
 				DistanceType worst_dist = result_set.worstDist();
 				for (IndexType i=node->lr.left; i<node->lr.right; ++i) {
 					const IndexType index = vind[i];// reorder... : i;
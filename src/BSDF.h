@@ -108,7 +108,7 @@ public:
 	void SetVisibility(std::shared_ptr<BSDFVisibility> copied) { visibility = copied; }
 
     float GetDistribution(const PathSegment& viewer, const PathSegment& incomingLight) const;// { return distribution->GetDistribution(viewer, incomingLight); }
-    Vector3 GetHemisphereSample(const PathSegment& viewer) const;// { return distribution->GetHemisphereSample(viewer); }
+    Vector3 GetHemisphereSample(ThreadContext& ctx, const PathSegment& viewer) const;// { return distribution->GetHemisphereSample(ctx, viewer); }
 	void SetDistribution(std::shared_ptr<Distribution> value) { distribution = value; }
 
 	virtual PathSegment Transmit(ThreadContext& ctx, PathSegment& incoming) const = 0;
@@ -128,7 +128,16 @@ public:
 	virtual Pixel ComputeIndirectIllumination(ThreadContext& ctx, const PathSegment& viewer, const PathSegment& incomingLight) const = 0;
 
 	Pixel ComputeLocalIllumination(ThreadContext& ctx, const PathSegment& viewer) const;
-	Pixel ComputeIndirectIllumination(ThreadContext& ctx, const PathSegment& view) const;
+
+	/*
+		Indirect illumination is gathered in two steps, so the hemisphere rays of many views can be
+		traced as one stream in between. SampleIndirectIllumination() appends "subSamples" untraced
+		hemisphere rays for "view", ComputeIndirectIllumination() expects the same rays traced to
+		their first impact (or none, if they left the scene) and the light estimated along each of
+		them, see RayTracer::EstimateIndirectIllumination().
+	*/
+	void SampleIndirectIllumination(ThreadContext& ctx, const PathSegment& view, std::vector<PathSegment>& outRays) const;
+	Pixel ComputeIndirectIllumination(ThreadContext& ctx, const PathSegment& view, const PathSegment* tracedRays, const Pixel* estimates) const;
 };
 
 class CausticBSDFBase : public BSDF
@@ -24,7 +24,7 @@ bool PathSegment::ImpactOnBackface() const { return GetTriangleAtImpact()->HasHi
 bool PathSegment::ImpactOnFrontface() const { return !ImpactOnBackface(); }
 const LightSource* PathSegment::GetLight() const { return GetSource() ? GetSource()->GetTriangleAtOrigin()->GetMesh()->GetLight() : nullptr; }
 
-BSDFMaterial::BSDFMaterial() : name(), settings(RenderSettings::Empty()), mTemplate()
+BSDFMaterial::BSDFMaterial() : name(), settings(RenderSettings::Empty()), bumpMapped(false), mTemplate()
 {
 }
 
@@ -35,6 +35,9 @@ std::shared_ptr<BSDFMaterial> BSDFMaterial::FromTemplate(std::shared_ptr<Unified
 	mat->mTemplate = mTemplate;
 	mat->name = mTemplate->GetString("Name");
 
+	// so far only the water material comes with a usable bump texture
+	mat->bumpMapped = (mat->name == "vcWatr");
+
 	auto reflective = ReflectiveBSDF::TryFromTemplate(mat);
 	auto refractive = RefractiveBSDF::TryFromTemplate(mat);
 	auto transparent = TransmissiveBSDF::TryFromTemplate(mat);
@@ -70,12 +73,14 @@ void BSDFMaterial::ApplyDefaultSettings(const RenderSettings& defaults)
 	for(auto& bsdf : lightingBsdfs) bsdf->ApplyDefaultSettings(settings);
 }
 
-Pixel BSDFMaterial::ShadeSurface(const PathSegment& view) const
+Pixel BSDFMaterial::ShadeSurface(ThreadContext& ctx, const PathSegment& view) const
 {
+	ctx.stats.bsdfEvaluations[EBsdfEvaluation::Surface]++;
+
 	if(surfaceBsdfs.empty())
 		return Pixel(1,1,1);
 	else
-		return ((SurfaceBSDFBase*)SelectBSDF(surfaceBsdfs, view))->ShadeSurface(view);
+		return ((SurfaceBSDFBase*)SelectBSDF(ctx.random.NextFloat(), surfaceBsdfs, view))->ShadeSurface(view);
 }
 
 void BSDFMaterial::TrackCameraPath(ThreadContext& ctx, PathSegment view, std::vector<std::shared_ptr<MultiplicativeBSDFEntry>>* outPath)
@@ -83,7 +88,7 @@ void BSDFMaterial::TrackCameraPath(ThreadContext& ctx, PathSegment view, std::ve
 	const PathSegment originalLine = view;
 	bool shouldContinue = true;
 
-	while(shouldContinue)
+	for(int depth = 0; shouldContinue; depth++)
 	{
 		shouldContinue = false;
 
@@ -95,7 +100,7 @@ void BSDFMaterial::TrackCameraPath(ThreadContext& ctx, PathSegment view, std::ve
 
 		MultiplicativeBSDFEntry bsdfEntry;
 
-		if(!view.HasImpact() && !ctx.CastRay(view, view))
+		if(!view.HasImpact() && !ctx.CastRay(view, view, ERayKind::Primary))
 		{
 			// we hit empty space
 			bsdfEntry.color = ctx.GetClearColor();
@@ -124,13 +129,15 @@ void BSDFMaterial::TrackCameraPath(ThreadContext& ctx, PathSegment view, std::ve
 		
 		if(!impactMat->causticBsdfs.empty())
 		{
-			auto causticBsdf = impactMat->SelectBSDF(impactMat->causticBsdfs, view);
+			auto causticBsdf = impactMat->SelectBSDF(ctx.sampler->Get1D(ESampleDimension::CausticSelection(depth)), impactMat->causticBsdfs, view);
 			PathSegment next;
 
 			bsdfEntry.probability = probCaustic;
 			bsdfEntry.bsdf = causticBsdf;
 			outPath->push_back(ctx.AllocateBsdfEntry(bsdfEntry));
 
+			ctx.stats.bsdfEvaluations[EBsdfEvaluation::TransmitCamera]++;
+
 			if(causticBsdf->TransmitCamera(ctx, view, &next))
 			{
 				shouldContinue = true;
@@ -146,7 +153,7 @@ void BSDFMaterial::TrackCameraPath(ThreadContext& ctx, PathSegment view, std::ve
 		if(!impactMat->lightingBsdfs.empty())
 		{
 			bsdfEntry.probability = probLighting;
-			bsdfEntry.bsdf = impactMat->SelectBSDF(impactMat->lightingBsdfs, view);
+			bsdfEntry.bsdf = impactMat->SelectBSDF(ctx.sampler->Get1D(ESampleDimension::LightingSelection(depth)), impactMat->lightingBsdfs, view);
 			outPath->push_back(ctx.AllocateBsdfEntry(bsdfEntry));
 		}
 	}
@@ -160,6 +167,8 @@ void BSDFMaterial::Transmit(ThreadContext& ctx, const PathSegment& incoming, std
 		const int bounceCount = copy.GetBounceCount();
 		PathSegment out = bouncingBsdfs[i]->Transmit(ctx, copy);
 
+		ctx.stats.bsdfEvaluations[EBsdfEvaluation::TransmitPhoton]++;
+
 		assert(bounceCount == out.GetBounceCount() - 1);
 
 		if(out.IsAlive())
@@ -168,7 +177,7 @@ void BSDFMaterial::Transmit(ThreadContext& ctx, const PathSegment& incoming, std
 }
 
 
-BSDF* BSDFMaterial::SelectBSDF(const PathSegment& view) const
+BSDF* BSDFMaterial::SelectBSDF(ThreadContext& ctx, const PathSegment& view) const
 {
 	float totalBsdfProbability = 0;
 	for(int i = 0; i < bouncingBsdfs.size(); i++)
@@ -176,7 +185,7 @@ BSDF* BSDFMaterial::SelectBSDF(const PathSegment& view) const
 		totalBsdfProbability += bouncingBsdfs[i]->GetVisibility()->Get(view);
 	}
 
-	float probValue = totalBsdfProbability * Math::GetRandomUnitFloat();
+	float probValue = totalBsdfProbability * Math::GetRandomUnitFloat(ctx.random);
 	int i = 0;
 	for(; i < bouncingBsdfs.size() - 1; i++)
 	{
@@ -192,7 +201,9 @@ BSDF* BSDFMaterial::SelectBSDF(const PathSegment& view) const
 
 BSDF* BSDFMaterial::TransmitCamera(ThreadContext& ctx, const PathSegment& view, PathSegment* next) const
 {
-	auto bsdf = SelectBSDF(causticBsdfs, view);
+	auto bsdf = SelectBSDF(ctx.random.NextFloat(), causticBsdfs, view);
+
+	ctx.stats.bsdfEvaluations[EBsdfEvaluation::TransmitCamera]++;
 	
 	if(!bsdf->TransmitCamera(ctx, view, next))
 	{
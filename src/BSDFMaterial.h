@@ -32,6 +32,7 @@ private:
 	std::string name;
 	RenderSettings settings;
 	std::shared_ptr<TextureMap> bumpTexture;
+	bool bumpMapped;
 	std::shared_ptr<UnifiedSettings> mTemplate;
 
 	void MakeInvalid();
@@ -93,8 +94,12 @@ public:
 
 	void ApplyDefaultSettings(const RenderSettings& defaults);
 
+	/*
+		Selects one of "bsdfs" proportional to its visibility, "sample" being uniformly
+		distributed in [0, 1).
+	*/
 	template<class TBSDFContainer>
-	BSDF* SelectBSDF(TBSDFContainer bsdfs, const PathSegment& view) const
+	BSDF* SelectBSDF(float sample, const TBSDFContainer& bsdfs, const PathSegment& view) const
 	{
 		float totalBsdfProbability = 0;
 		for(int i = 0; i < bsdfs.size(); i++)
@@ -102,7 +107,7 @@ public:
 			totalBsdfProbability += bsdfs[i]->GetVisibility()->Get(view);
 		}
 
-		float probValue = totalBsdfProbability * Math::GetRandomUnitFloat();
+		float probValue = totalBsdfProbability * sample;
 		int i = 0;
 		for(; i < bsdfs.size() - 1; i++)
 		{
@@ -117,8 +122,8 @@ public:
 	}
 
 	bool HasCausticBsdfs() const { return !causticBsdfs.empty(); }
-	Pixel ShadeSurface(const PathSegment& view) const;
-	BSDF* SelectBSDF(const PathSegment& view) const;
+	Pixel ShadeSurface(ThreadContext& ctx, const PathSegment& view) const;
+	BSDF* SelectBSDF(ThreadContext& ctx, const PathSegment& view) const;
 	void Transmit(ThreadContext& ctx, const PathSegment& incoming, std::vector<std::pair<PathSegment, PathSegment>>& transmissions) const;
 	BSDF* TransmitCamera(ThreadContext& ctx, const PathSegment& view, PathSegment* next) const;
 	int GetShadowSampleCount(ThreadContext& ctx, const PathSegment& view) const;
@@ -126,6 +131,8 @@ public:
 	std::shared_ptr<TextureMap> ShareBumpTexture() const { return bumpTexture; }
 	const TextureMap* GetBumpTexture() const { return bumpTexture.get(); }
 	void SetBumpTexture(std::shared_ptr<TextureMap> value) { bumpTexture = value; }
+	/** Whether normals get perturbed by the bump texture, decided once per material. */
+	bool IsBumpMapped() const { return bumpMapped && bumpTexture; }
 
 	Pixel ComputeLocalIllumination(ThreadContext& ctx, const PathSegment& photon) const;
 };
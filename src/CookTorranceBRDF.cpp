@@ -30,7 +30,7 @@ PathSegment CookTorranceBSDF::Transmit(ThreadContext& ctx, PathSegment& incoming
 
 	segment.Bounce();
 	segment.SetOrigin(incoming.GetImpact());
-	segment.SetDirection(Math::GetRandomVectorInUnitHalfSphere(incoming.GetNormalAtImpact()));
+	segment.SetDirection(Math::GetRandomVectorInUnitHalfSphere(ctx.random, incoming.GetNormalAtImpact()));
 	segment.ClearSource();
 
 	return segment;
@@ -23,7 +23,7 @@ float CosineDistribution::GetDistribution(const PathSegment& viewer, const PathS
 	return Math::Saturate(-(incomingLight.GetDirection() ^ incomingLight.GetNormalAtImpact()));
 }
 
-Vector3 CosineDistribution::GetHemisphereSample(const PathSegment& viewer) const 
+Vector3 CosineDistribution::GetHemisphereSample(ThreadContext& ctx, const PathSegment& viewer) const 
 {
 	// importance sampling from hemisphere (basically favors direction yielding high values
 	// for cosine, since this is the illumination factor for lambertian materials). Will
@@ -32,8 +32,11 @@ Vector3 CosineDistribution::GetHemisphereSample(const PathSegment& viewer) const
 	// Source: http://pathtracing.wordpress.com/2011/03/03/cosine-weighted-hemisphere/
 	const Vector3 n = viewer.GetNormalAtImpact();
 
-	float Xi1 = Math::GetRandomUnitFloat();
-	float Xi2 = Math::GetRandomUnitFloat();
+	float Xi[2];
+	ctx.random.NextFloats(Xi, 2);
+
+	float Xi1 = Xi[0];
+	float Xi2 = Xi[1];
 
 	float  theta = acos(sqrt(1.0f - Xi1));
 	float  phi = 2.0f * Math::PI * Xi2;
@@ -78,10 +81,10 @@ float PowerCosineDistribution::GetDistribution(const PathSegment& viewer, const
 	return norm2 * std::pow(std::abs(cosTheta), glossy);
 }
 
-Vector3 PowerCosineDistribution::GetHemisphereSample(const PathSegment& viewer) const 
+Vector3 PowerCosineDistribution::GetHemisphereSample(ThreadContext& ctx, const PathSegment& viewer) const 
 {
 	// http://cg.informatik.uni-freiburg.de/course_notes/graphics2_04_sampling.pdf
-	Vector3 disc = Math::AbsPerElem(Math::GetRandomVectorInUnitDisc());
+	Vector3 disc = Math::AbsPerElem(Math::GetRandomVectorInUnitDisc(ctx.random));
 	const Vector3 w = viewer.GetNormalAtImpact();
 	const Vector3 u = Math::GetOrthogonal(w);
 	const Vector3 v = Math::Cross(w, u);
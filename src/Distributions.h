@@ -20,7 +20,7 @@ class Distribution
 {
 public:
 	virtual float GetDistribution(const PathSegment& viewer, const PathSegment& incomingLight) const = 0;
-	virtual Vector3 GetHemisphereSample(const PathSegment& viewer) const = 0;
+	virtual Vector3 GetHemisphereSample(ThreadContext& ctx, const PathSegment& viewer) const = 0;
 };
 
 class CosineDistribution : public Distribution
@@ -30,7 +30,7 @@ public:
 	CosineDistribution() { }
 
 	float GetDistribution(const PathSegment& viewer, const PathSegment& incomingLight) const override;
-	Vector3 GetHemisphereSample(const PathSegment& viewer) const override;
+	Vector3 GetHemisphereSample(ThreadContext& ctx, const PathSegment& viewer) const override;
 };
 
 class PowerCosineDistribution : public Distribution
@@ -51,5 +51,5 @@ public:
 	static Vector3 GetHalfVector(const PathSegment& viewer, const PathSegment& incomingLight);
 
 	float GetDistribution(const PathSegment& viewer, const PathSegment& incomingLight) const override;
-	Vector3 GetHemisphereSample(const PathSegment& viewer) const override;
+	Vector3 GetHemisphereSample(ThreadContext& ctx, const PathSegment& viewer) const override;
 };
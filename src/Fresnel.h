@@ -15,6 +15,59 @@
 // ======================================================================== //
 
 
+/*
+	Reflection and refraction directions and their Fresnel weights at the impact of "incoming".
+*/
+struct FresnelTerm
+{
+	float n1, n2; 
+	Vector3 normal;
+	Vector3 reflectDir;
+	Vector3 refractDir;
+	float refractWeight;
+	float reflectWeight;
+
+	FresnelTerm(const PathSegment& incoming, float refractionIndex)
+	{
+		normal = incoming.GetNormalAtImpact();
+
+		if(incoming.ImpactOnFrontface())
+		{
+			// from outside the object
+			n1 = 1;
+			n2 = refractionIndex;
+		}
+		else
+		{
+			// from inside the object
+			n1 = refractionIndex;
+			n2 = 1;
+		}
+
+		float eta = n1/n2;
+		float cosI = -(incoming.GetDirection() ^ normal);
+		float sinT = eta*eta*(1 - cosI*cosI);
+
+		reflectWeight = 1;
+		reflectDir = incoming.GetDirection() + 2*cosI*normal;
+
+		if(sinT < 1)
+		{
+			float cosT = std::sqrtf(1 - sinT);
+			refractDir = eta*incoming.GetDirection() + (eta*cosI - cosT) * normal;
+
+			float ROi = (n1*cosI - n2*cosT) / (n1*cosI + n2*cosT);
+			float RPi = (n2*cosI - n1*cosT) / (n2*cosI + n1*cosT);
+
+			ROi *= ROi;
+			RPi *= RPi;
+
+			reflectWeight = std::min(1.0f, (ROi + RPi) / 2);
+		}
+
+		refractWeight = 1 - reflectWeight;
+	}
+};
 
 class FresnelReflectance : public BSDFVisibility
 {
@@ -50,7 +50,7 @@ PathSegment LambertBSDF::Transmit(ThreadContext& ctx, PathSegment& incoming) con
 
 	segment.Bounce();
 	segment.SetOrigin(incoming.GetImpact());
-	segment.SetDirection(Math::GetRandomVectorInUnitHalfSphere(incoming.GetNormalAtImpact()));
+	segment.SetDirection(Math::GetRandomVectorInUnitHalfSphere(ctx.random, incoming.GetNormalAtImpact()));
 	segment.ClearSource();
 
 	return segment;
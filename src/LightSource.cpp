@@ -20,23 +20,24 @@
 LightSource::LightSource(std::shared_ptr<Mesh> mesh)
 	:
 	mesh(mesh),
-	maximumProbability(0),
 	isDirectional(false),
 	color(1,1,1),
 	texture(),
 	index(-1),
 	intensity(1), 
-	photonMultiplier(1)
+	photonMultiplier(1),
+	photonScale(1),
+	area(0)
 {
-	float prob = 0;
+	std::vector<double> areas;
 
 	for(auto& tri : mesh->GetTriangles())
 	{
-		probToTriangle[prob] = &tri;
-		prob += tri.GetArea();
+		areas.push_back(tri.GetArea());
+		area += areas.back();
 	}
 
-	maximumProbability = prob - mesh->GetTriangles().back().GetArea();
+	triangleByArea.Build(areas);
 }
 
 std::shared_ptr<LightSource> LightSource::TryFromTemplate(std::shared_ptr<UnifiedSettings> settings, std::shared_ptr<Mesh> mesh)
@@ -53,20 +54,21 @@ std::shared_ptr<LightSource> LightSource::TryFromTemplate(std::shared_ptr<Unifie
 	return light;
 }
 
-bool LightSource::EmitPhoton(ThreadContext& ctx) const
+bool LightSource::EmitPhoton(ThreadContext& ctx, int sample, int sampleCount) const
 {
-	double prob = Math::GetRandomUnitFloat() * maximumProbability;
-	int index = probToTriangle.lower_bound(prob)->second->GetFaceIndex();
+	double u = (sample + Math::GetRandomUnitFloat(ctx.random)) / sampleCount;
+	int index = mesh->GetTriangleByIndex(triangleByArea.Sample(u)).GetFaceIndex();
 	const Triangle* triangle = &ctx.GetTracer()->GetTriangles()[index];
 
-	Vector3 origin = triangle->GetRandomPoint();
-	Vector3 direction = triangle->GetNormal(origin);
+	Vector3 uv = triangle->GetRandomBarycentrics(ctx.random);
+	Vector3 origin = triangle->GetPoint(uv.x, uv.y);
+	Vector3 direction = triangle->GetNormal(uv.x, uv.y);
 
 	if(!isDirectional)
-		direction = Math::GetRandomVectorInUnitHalfSphere(direction, 0);
+		direction = Math::GetRandomVectorInUnitHalfSphere(ctx.random, direction, 0);
 
 	Pixel color = GetColor();
-	color *= GetIntensity() * ctx.GetTracer()->GetSettings().photonIntensity;
+	color *= GetIntensity() * GetPhotonScale() * ctx.GetTracer()->GetSettings().photonIntensity;
 
 	// insert segment from light source to first impact into photon maps
 	PathSegment emitted;
@@ -77,7 +79,7 @@ bool LightSource::EmitPhoton(ThreadContext& ctx) const
 	emitted.SetTriangleAtImpact(triangle); // will be updated during raycast, for now prevents self-intersection!
 	emitted.SetColor(color);
 
-	if(!ctx.CastRay(emitted, emitted))
+	if(!ctx.CastRay(emitted, emitted, ERayKind::Photon))
 		return false; // we hit empty space, this photon is not going to do any good...
 
 	PathSegment* allocated = ctx.GetDirectMap().Insert(emitted);
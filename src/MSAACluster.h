@@ -58,7 +58,7 @@ public:
 	}
 
 	template<class TPhotons>
-	void Initialize(MultiplicativeBSDFEntry* bsdfEntry, TPhotons photonSource) 
+	void Initialize(MultiplicativeBSDFEntry* bsdfEntry, const TPhotons& photonSource) 
 	{
 		Reset();
 		
@@ -93,8 +93,8 @@ public:
 		return true;
 	}
 
-	MultiplicativeBSDFEntry* SelectEntry() const
+	MultiplicativeBSDFEntry* SelectEntry(RandomGenerator& random) const
 	{
-		return entries[std::rand() % entries.size()];
+		return entries[random.NextInt((int)entries.size())];
 	}
 };
\ No newline at end of file
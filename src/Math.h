@@ -15,6 +15,7 @@
 // ======================================================================== //
 
 #include "Pixel.h"
+#include "Random.h"
 
 #ifndef __WIN32
 #   define __forceinline
@@ -28,8 +29,6 @@
 #include <common/accel.h>
 #include <common/intersector.h>
 
-#include <random>
-
 typedef Vectormath::Aos::Matrix3 Matrix3x3;
 typedef Vectormath::Aos::Matrix4 Matrix4x4;
 typedef embree::Vec3f Vector3;
@@ -37,12 +36,133 @@ typedef embree::Vec4f Vector4;
 typedef embree::Ray Ray;
 typedef embree::Quaternion3f Quaternion;
 
+/*
+	Base-2 radical inverse sequence with random digit scrambling. This is the first
+	dimension of the Sobol (0,2)-sequence used by SobolSampler.
+*/
 struct VanDerCorputSequence
 {
-	VanDerCorputSequence();
-	VanDerCorputSequence(int seed);
+private:
+	uint32_t index;
+	uint32_t scramble;
+
+public:
+	VanDerCorputSequence() : index(0), scramble(0) { }
+	VanDerCorputSequence(int seed) : index(0), scramble((uint32_t)seed) { }
+
+	double Next() { return ToUnitFloat(RadicalInverse(index++, scramble)); }
+
+	/** Mirrors the bits of "index" at the binary point and XORs the result with "scramble". */
+	static uint32_t RadicalInverse(uint32_t index, uint32_t scramble = 0)
+	{
+		index = (index << 16) | (index >> 16);
+		index = ((index & 0x00FF00FF) << 8) | ((index & 0xFF00FF00) >> 8);
+		index = ((index & 0x0F0F0F0F) << 4) | ((index & 0xF0F0F0F0) >> 4);
+		index = ((index & 0x33333333) << 2) | ((index & 0xCCCCCCCC) >> 2);
+		index = ((index & 0x55555555) << 1) | ((index & 0xAAAAAAAA) >> 1);
+		return index ^ scramble;
+	}
+
+	/** Second dimension of the Sobol sequence, also XOR scrambled. */
+	static uint32_t Sobol2(uint32_t index, uint32_t scramble = 0)
+	{
+		for(uint32_t v = 1u << 31; index != 0; index >>= 1, v ^= v >> 1)
+		{
+			if(index & 1)
+				scramble ^= v;
+		}
+		return scramble;
+	}
+
+	/** Maps 32 fixed point bits into [0, 1). */
+	static float ToUnitFloat(uint32_t bits)
+	{
+		return (bits >> 8) * (1.0f / 16777216.0f);
+	}
+};
+
+/*
+	Walker's alias method, built with Vose's algorithm. Draws an index proportional to its
+	weight in constant time: "u" picks a column uniformly and its fractional position in that
+	column decides between the column and its alias.
+*/
+class AliasTable
+{
+private:
+	struct Column
+	{
+		float probability;
+		int alias;
+	};
+
+	std::vector<Column> columns;
+
+public:
+	AliasTable() { }
+	AliasTable(const std::vector<double>& weights) { Build(weights); }
+
+	int GetSize() const { return (int)columns.size(); }
+
+	void Build(const std::vector<double>& weights)
+	{
+		const int n = (int)weights.size();
+		double total = 0;
+		std::vector<double> scaled(n);
+		std::vector<int> small, large;
+
+		for(double weight : weights)
+			total += weight;
+
+		columns.resize(n);
+
+		for(int i = 0; i < n; i++)
+		{
+			// all weights zero is treated like all weights equal
+			scaled[i] = (total > 0) ? weights[i] * n / total : 1.0;
+
+			if(scaled[i] < 1)
+				small.push_back(i);
+			else
+				large.push_back(i);
+		}
+
+		while(!small.empty() && !large.empty())
+		{
+			const int less = small.back(), more = large.back();
+
+			small.pop_back();
+			large.pop_back();
+
+			columns[less].probability = (float)scaled[less];
+			columns[less].alias = more;
+
+			scaled[more] = (scaled[more] + scaled[less]) - 1;
+
+			if(scaled[more] < 1)
+				small.push_back(more);
+			else
+				large.push_back(more);
+		}
 
-	double Next() const;
+		// leftovers are only off from one by rounding errors
+		small.insert(small.end(), large.begin(), large.end());
+
+		for(int i : small)
+		{
+			columns[i].probability = 1;
+			columns[i].alias = i;
+		}
+	}
+
+	/** "u" is uniformly distributed in [0, 1). */
+	int Sample(double u) const
+	{
+		const double scaled = u * columns.size();
+		const int i = std::min((int)scaled, (int)columns.size() - 1);
+		const Column& column = columns[i];
+
+		return ((scaled - i) < column.probability) ? i : column.alias;
+	}
 };
 
 inline float operator^(const Vector3& a, const Vector3& b)
@@ -57,8 +177,6 @@ inline Vector3 operator*(const Vector3& a, const Vector3& b)
 
 namespace Math
 {
-	static std::mt19937 randomNumberGenerator;
-
 	static const float PI = 3.14159265359f;
 	static const float PIInverse = 1/3.14159265359f;
 
@@ -74,10 +192,9 @@ namespace Math
 	static float Length(Vector3 a) { return embree::length(a); }
 	static float LengthSqr(Vector3 a) { return embree::length(a) * embree::length(a); }
 	static Vector3 Normalized(Vector3 a) { return embree::normalize(a); }
-	static float GetRandomUnitFloat() 
+	static float GetRandomUnitFloat(RandomGenerator& random) 
 	{
-		std::uniform_real_distribution<float> dist(0, 1);
-		return dist(randomNumberGenerator);
+		return random.NextFloat();
 	}
 
 	static Quaternion RotateAroundUnit(Vector3 axis, float radians)
@@ -239,33 +356,37 @@ namespace Math
 		return IsZero(a.x, epsilon) && IsZero(a.y, epsilon) && IsZero(a.z, epsilon);
 	}
 
-	static Vector3 GetRandomVectorInUnitQuad()
+	static Vector3 GetRandomVectorInUnitQuad(RandomGenerator& random)
 	{
-		return Vector3(1 - 2 * Math::GetRandomUnitFloat(), 1 - 2 * Math::GetRandomUnitFloat(), 0);
+		float xy[2];
+		random.NextFloats(xy, 2);
+		return Vector3(1 - 2 * xy[0], 1 - 2 * xy[1], 0);
 	}
 
-	static Vector3 GetRandomVectorInUnitCube()
+	static Vector3 GetRandomVectorInUnitCube(RandomGenerator& random)
 	{
-		return Vector3(1 - 2 * Math::GetRandomUnitFloat(), 1 - 2 * Math::GetRandomUnitFloat(), 1 - 2 * Math::GetRandomUnitFloat());
+		float xyz[3];
+		random.NextFloats(xyz, 3);
+		return Vector3(1 - 2 * xyz[0], 1 - 2 * xyz[1], 1 - 2 * xyz[2]);
 	}
 
-	static Vector3 GetRandomVectorInUnitSphere()
+	static Vector3 GetRandomVectorInUnitSphere(RandomGenerator& random)
 	{
 		// rejection sampling...
 		Vector3 res;
-		while(Math::Length(res = GetRandomVectorInUnitCube()) > 1);
+		while(Math::Length(res = GetRandomVectorInUnitCube(random)) > 1);
 		return res;
 	}
 
-	static Vector3 GetRandomVectorInUnitDisc()
+	static Vector3 GetRandomVectorInUnitDisc(RandomGenerator& random)
 	{
 		// rejection sampling...
 		Vector3 res;
-		while(Math::Length(res = GetRandomVectorInUnitQuad()) > 1);
+		while(Math::Length(res = GetRandomVectorInUnitQuad(random)) > 1);
 		return res;
 	}
 
-	static Vector3 GetRandomVectorInSolidAngle(Vector3 planeNormal, float maxPhi)
+	static Vector3 GetRandomVectorInSolidAngle(RandomGenerator& random, Vector3 planeNormal, float maxPhi)
 	{
 		if(maxPhi < 0.01f)
 			return planeNormal;
@@ -276,23 +397,54 @@ namespace Math
 		// what we want, but for smaller maxPhi's, which is the use-case, it is a good
 		// approximation of a uniform distribution!
 		float adjacentLen = 1.0f / std::tanf(maxPhi / 2);
-		Vector3 adjacent = Math::Normalized(GetRandomVectorInUnitDisc() + Vector3(0,adjacentLen,0));
+		Vector3 adjacent = Math::Normalized(GetRandomVectorInUnitDisc(random) + Vector3(0,adjacentLen,0));
 
 		// now rotate this sample into our target coordinate frame
 		auto rot = Vectormath::Aos::Quat::rotation(Math::Convert(Vector3(0,1,0)), Math::Convert(planeNormal));
 		return Math::Convert(Vectormath::Aos::rotate(rot, Math::Convert(adjacent)));
 	} 
 
-	static Vector3 GetRandomVectorInUnitHalfSphere(Vector3 planeNormal, float eta = 0)
+	static Vector3 GetRandomVectorInUnitHalfSphere(RandomGenerator& random, Vector3 planeNormal, float eta = 0)
 	{
 		// rejection sampling...
 		Vector3 res;
 		int i = 0;
 		eta = std::min(std::max(eta, 0.0f), 0.9f);
-		while((((res = GetRandomVectorInUnitSphere()) ^ planeNormal) < eta) && (i++ < 100));
+		while((((res = GetRandomVectorInUnitSphere(random)) ^ planeNormal) < eta) && (i++ < 100));
 		return (i < 100) ? res : planeNormal;
 	} 
 
+	/*
+		Builds an orthonormal basis around the unit vector "normal" without branching on
+		special axes (Duff et al., "Building an Orthonormal Basis, Revisited").
+	*/
+	static void GetOrthonormalBasis(const Vector3& normal, Vector3& tangent, Vector3& bitangent)
+	{
+		float sign = (normal.z < 0) ? -1.0f : 1.0f;
+		float a = -1.0f / (sign + normal.z);
+		float b = normal.x * normal.y * a;
+
+		tangent = Vector3(1.0f + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+		bitangent = Vector3(b, sign + normal.y * normal.y * a, -normal.y);
+	}
+
+	/*
+		Maps a point of the unit square onto the half sphere around "planeNormal". The result
+		has the same (uniform) distribution as GetRandomVectorInUnitHalfSphere() with eta = 0,
+		but preserves the stratification of the input points, so it can be fed by a Sampler.
+	*/
+	static Vector3 MapToUnitHalfSphere(const Vector3& planeNormal, float u1, float u2)
+	{
+		Vector3 tangent, bitangent;
+		float z = u1;
+		float r = std::sqrt(std::max(0.0f, 1 - z * z));
+		float phi = 2 * PI * u2;
+
+		GetOrthonormalBasis(planeNormal, tangent, bitangent);
+
+		return (r * std::cos(phi)) * tangent + (r * std::sin(phi)) * bitangent + z * planeNormal;
+	}
+
 	static Vector3 GetOrthogonal(const Vector3& vec)
 	{
 		bool xZ = !Math::AreClose(vec.x, 0);
@@ -312,6 +464,22 @@ namespace Math
 	}
 
 	static float Saturate(float value) { return Math::Clamp(value, 0.0f, 1.0f); }
+
+	/** Interleaves the lower 10 bits of "x", "y" and "z" into a 30 bit Morton code, "x" taking the lowest bit. */
+	static uint32_t MortonCode(uint32_t x, uint32_t y, uint32_t z)
+	{
+		auto spread = [](uint32_t v)
+		{
+			v &= 0x3FF;
+			v = (v | (v << 16)) & 0x030000FF;
+			v = (v | (v << 8)) & 0x0300F00F;
+			v = (v | (v << 4)) & 0x030C30C3;
+			v = (v | (v << 2)) & 0x09249249;
+			return v;
+		};
+
+		return spread(x) | (spread(y) << 1) | (spread(z) << 2);
+	}
     
     template<class T>
     static T Sign(T value) {
@@ -342,6 +510,7 @@ struct Triangle
 {
 private:
 	friend RayTracer;
+	friend class Mesh;
 
 	int a, b, c;
 	Mesh* mesh;
@@ -359,15 +528,29 @@ public:
 	Vector3 GetTexCoordA() const;
 	Vector3 GetTexCoordB() const;
 	Vector3 GetTexCoordC() const;
+	// indices into the vertices of the mesh, shared with neighbouring triangles
+	int GetVertexIndexA() const { return a; }
+	int GetVertexIndexB() const { return b; }
+	int GetVertexIndexC() const { return c; }
 	Vector3 GetNormal(const PathSegment& where) const;
 	Vector3 GetNormal(const Vector3& where) const;
+
+	/*
+		Barycentric attributes, "u" and "v" being the weights of B and C like in embree's hits, so
+		that A * (1 - u - v) + B * u + C * v is the point on the triangle.
+	*/
+	Vector3 GetPoint(float u, float v) const;
+	Vector3 GetTexCoord(float u, float v) const;
+	Vector3 GetNormal(float u, float v) const;
+	/** "u" and "v" of the point on the triangle closest to "where" as x and y. */
+	Vector3 GetBarycentrics(const Vector3& where) const;
 	int GetFaceIndex() const;
 	bool HasHitBackface(Vector3 worldNormal) const;
 
 	Vector3 WorldToUv(Vector3 world) const;
 	Matrix3x3 ComputeWorldToUvMatrix() const;
 	float GetArea() const;
-	Vector3 GetRandomPoint() const;
+	Vector3 GetRandomBarycentrics(RandomGenerator& random) const;
 
 	Triangle(Mesh* mesh, int vertexA, int vertexB, int vertexC);
 
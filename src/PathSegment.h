@@ -33,6 +33,7 @@ private:
 	ThreadContext* context;
 	Vector3 origin;
 	Vector3 destination;
+	float impactU, impactV; // barycentrics of "destination" on "dstTriangle", negative if unknown
 	Vector3 direction;
 	const Triangle* dstTriangle;
 	const Triangle* srcTriangle;
@@ -51,6 +52,8 @@ public:
 		context(nullptr),
 		origin(0,0,0), 
 		destination(0,0,0), 
+		impactU(-1),
+		impactV(-1),
 		direction(0,0,0),
 		dstTriangle(nullptr),
 		srcTriangle(nullptr),
@@ -66,6 +69,8 @@ public:
 		result.color = from.GetColor();
 		result.context = from.context;
 		result.destination = to.destination;
+		result.impactU = to.impactU;
+		result.impactV = to.impactV;
 		result.origin = from.destination;
 		result.direction = Math::Normalized(result.destination - result.origin);
 		result.dstTriangle = to.dstTriangle;
@@ -79,6 +84,7 @@ public:
 		PathSegment result = segment;
 
 		result.destination = segment.origin;
+		result.impactU = result.impactV = -1;
 		result.origin = segment.destination;
 		result.direction = -segment.direction;
 		result.dstTriangle = segment.srcTriangle;
@@ -94,6 +100,10 @@ public:
 	Pixel GetColor() const { return color; }
 	Vector3 GetOrigin() const { return origin; }
 	Vector3 GetImpact() const { return destination; }
+	bool HasBarycentrics() const { return impactU >= 0; }
+	float GetImpactU() const { return impactU; }
+	float GetImpactV() const { return impactV; }
+	Vector3 GetTexCoordAtImpact() const { return HasBarycentrics() ? dstTriangle->GetTexCoord(impactU, impactV) : dstTriangle->WorldToUv(destination); }
 	const Triangle* GetTriangleAtImpact() const { return dstTriangle; }
 	const Triangle* GetTriangleAtOrigin() const { return srcTriangle; }
 	const Mesh* GetMeshAtImpact() const { return dstTriangle->GetMesh(); }
@@ -118,9 +128,12 @@ public:
 	const LightSource* GetLight() const;
 	const PathSegment* GetSource() const { return source; }
 
-	void ResetImpact() { destination = Math::InvalidVector3(); dstTriangle = nullptr; }
+	void ResetImpact() { destination = Math::InvalidVector3(); impactU = impactV = -1; dstTriangle = nullptr; }
 	void SetWeight(float value) { weight = value; }
-	void SetImpact(Vector3 value) { destination = value; }
+	void SetImpact(Vector3 value) { destination = value; impactU = impactV = -1; }
+	void SetImpact(Vector3 value, float u, float v) { destination = value; impactU = u; impactV = v; }
+	/** Takes over impact, barycentrics and triangle at impact of "other". */
+	void CopyImpact(const PathSegment& other) { destination = other.destination; impactU = other.impactU; impactV = other.impactV; dstTriangle = other.dstTriangle; }
 	void SetTriangleAtImpact(const Triangle* value) { dstTriangle = value; }
 	void SetTriangleAtOrigin(const Triangle* value) { srcTriangle = value; }
 	void SetPrevSegment(const PathSegment* segment) { prevSegment = segment; }
@@ -17,19 +17,21 @@
 
 #include "stdafx.h"
 
+const int PhotonMap::BATCH_SIZE;
+
 float PhotonMap::kdtree_distance(const float* p1, const size_t idx_p2, size_t size) const
 {
-	auto d0= p1[0] - registeredPhotons[idx_p2]->GetImpact().x;
-	auto d1= p1[1] - registeredPhotons[idx_p2]->GetImpact().y;
-	auto d2= p1[2] - registeredPhotons[idx_p2]->GetImpact().z;
+	auto d0= p1[0] - positionX[idx_p2];
+	auto d1= p1[1] - positionY[idx_p2];
+	auto d2= p1[2] - positionZ[idx_p2];
 	return d0*d0+d1*d1+d2*d2;
 }
 
 float PhotonMap::kdtree_get_pt(const size_t idx, int dim) const
 {
-	if (dim == 0) return registeredPhotons[idx]->GetImpact().x;
-	else if (dim == 1) return registeredPhotons[idx]->GetImpact().y;
-	else return registeredPhotons[idx]->GetImpact().z;
+	if (dim == 0) return positionX[idx];
+	else if (dim == 1) return positionY[idx];
+	else return positionZ[idx];
 }
 
 void PhotonMap::Register(PathSegment* photon) 
@@ -76,31 +78,751 @@ PhotonMap::PhotonMap(RayTracer& rayTracer, int totalPhotonCount)
 		photonStorage(totalPhotonCount),
 		registeredPhotons(totalPhotonCount),
 		photonStorageIndex(0),
-		photonRegisterIndex(0)
+		photonRegisterIndex(0),
+		lookup(EPhotonLookup::KDTree),
+		gridCellSize(0),
+		gridCellExtent(0)
+{
+}
+
+
+nanoflann::PooledAllocator& PhotonMap::KDTree::AddAllocator()
+{
+	std::lock_guard<std::mutex> lock(allocatorMutex);
+
+	allocators.push_back(std::make_unique<nanoflann::PooledAllocator>());
+
+	return *allocators.back();
+}
+
+PhotonMap::KDTree::NodePtr PhotonMap::KDTree::DivideTree(TaskPool& pool, int workerIndex, nanoflann::PooledAllocator& allocator, size_t left, size_t right, BoundingBox& bbox)
+{
+	// follows KDTreeSingleIndexAdaptor::divideTree(), so the result does not depend on the thread count
+	const size_t PARALLEL_SUBTREE_SIZE = 64 * 1024;
+	NodePtr node = allocator.allocate<Node>();
+
+	if((right - left) <= m_leaf_max_size)
+	{
+		node->child1 = node->child2 = NULL;
+		node->lr.left = left;
+		node->lr.right = right;
+
+		for(int i = 0; i < 3; i++)
+		{
+			bbox[i].low = bbox[i].high = dataset_get(vind[left], i);
+		}
+
+		for(size_t k = left + 1; k < right; k++)
+		{
+			for(int i = 0; i < 3; i++)
+			{
+				bbox[i].low = std::min(bbox[i].low, dataset_get(vind[k], i));
+				bbox[i].high = std::max(bbox[i].high, dataset_get(vind[k], i));
+			}
+		}
+
+		return node;
+	}
+
+	size_t idx;
+	int cutfeat;
+	DistanceType cutval;
+
+	middleSplit_(&vind[0] + left, right - left, idx, cutfeat, cutval, bbox);
+
+	node->sub.divfeat = cutfeat;
+
+	BoundingBox left_bbox(bbox);
+	BoundingBox right_bbox(bbox);
+
+	left_bbox[cutfeat].high = cutval;
+	right_bbox[cutfeat].low = cutval;
+
+	if((right - left) >= PARALLEL_SUBTREE_SIZE)
+	{
+		// the left half goes to another task with its own node memory, this one continues with the right half
+		TaskGroup group;
+		nanoflann::PooledAllocator& leftAllocator = AddAllocator();
+
+		pool.Submit(group, [&](int leftWorker)
+		{
+			node->child1 = DivideTree(pool, leftWorker, leftAllocator, left, left + idx, left_bbox);
+		}, workerIndex);
+
+		try
+		{
+			node->child2 = DivideTree(pool, workerIndex, allocator, left + idx, right, right_bbox);
+		}
+		catch(...)
+		{
+			// the left task writes through references into this frame, so it has to finish before unwinding
+			try
+			{
+				pool.Wait(group, workerIndex);
+			}
+			catch(...)
+			{
+				// the right half's exception is the one reported
+			}
+
+			throw;
+		}
+
+		pool.Wait(group, workerIndex);
+	}
+	else
+	{
+		node->child1 = DivideTree(pool, workerIndex, allocator, left, left + idx, left_bbox);
+		node->child2 = DivideTree(pool, workerIndex, allocator, left + idx, right, right_bbox);
+	}
+
+	node->sub.divlow = left_bbox[cutfeat].high;
+	node->sub.divhigh = right_bbox[cutfeat].low;
+
+	for(int i = 0; i < 3; i++)
+	{
+		bbox[i].low = std::min(left_bbox[i].low, right_bbox[i].low);
+		bbox[i].high = std::max(left_bbox[i].high, right_bbox[i].high);
+	}
+
+	return node;
+}
+
+void PhotonMap::KDTree::BuildIndex(TaskPool& pool, int workerIndex)
 {
+	init_vind();
+	computeBoundingBox(root_bbox);
+	root_node = DivideTree(pool, workerIndex, KDTreeBase::pool, 0, m_size, root_bbox);
 }
 
+void PhotonMap::BatchQuery::AddPhoton(float distance, size_t index)
+{
+	int i = 0;
+
+	if(count < capacity)
+	{
+		// sift the new photon up from the end
+		for(i = count++; i > 0; )
+		{
+			const int parent = (i - 1) / 2;
+
+			if(distances[parent] >= distance)
+				break;
+
+			distances[i] = distances[parent];
+			indices[i] = indices[parent];
+			i = parent;
+		}
+	}
+	else
+	{
+		// replace the farthest photon and sift the new one down
+		for(int child = 1; child < count; child = 2 * i + 1)
+		{
+			if((child + 1 < count) && (distances[child + 1] > distances[child]))
+				child++;
 
-void PhotonMap::Build()
+			if(distances[child] <= distance)
+				break;
+
+			distances[i] = distances[child];
+			indices[i] = indices[child];
+			i = child;
+		}
+	}
+
+	distances[i] = distance;
+	indices[i] = index;
+}
+
+void PhotonMap::KDTree::SearchLeafBatch(NodePtr node, BatchQuery* queries, const int* active, int activeCount) const
 {
-	kdTree = std::make_shared<KDTree>(3, *this, nanoflann::KDTreeSingleIndexAdaptorParams(10));
+	const size_t left = node->lr.left, right = node->lr.right;
 
-	if(GetRegisteredPhotonCount() > 0)
+	// four queries per register, unused lanes have a negative bound and never accept a photon
+	for(int group = 0; group < activeCount; group += 4)
 	{
-		kdTree->buildIndex();
+		const int lanes = std::min(4, activeCount - group);
+		alignas(16) float x[4] = { 0, 0, 0, 0 }, y[4] = { 0, 0, 0, 0 }, z[4] = { 0, 0, 0, 0 }, worst[4] = { -1, -1, -1, -1 };
+
+		for(int lane = 0; lane < lanes; lane++)
+		{
+			BatchQuery& query = queries[active[group + lane]];
+
+			x[lane] = query.point[0];
+			y[lane] = query.point[1];
+			z[lane] = query.point[2];
+			worst[lane] = query.GetWorstDistance();
+			query.visited += right - left;
+		}
+
+		const __m128 queryX = _mm_load_ps(x), queryY = _mm_load_ps(y), queryZ = _mm_load_ps(z);
+		__m128 queryWorst = _mm_load_ps(worst);
+
+		for(size_t i = left; i < right; i++)
+		{
+			// same operations as kdtree_distance(), so distances match those the tree was built with
+			const __m128 d0 = _mm_sub_ps(queryX, _mm_set1_ps(dataset.positionX[i]));
+			const __m128 d1 = _mm_sub_ps(queryY, _mm_set1_ps(dataset.positionY[i]));
+			const __m128 d2 = _mm_sub_ps(queryZ, _mm_set1_ps(dataset.positionZ[i]));
+			const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, d0), _mm_mul_ps(d1, d1)), _mm_mul_ps(d2, d2));
+			const int accepted = _mm_movemask_ps(_mm_cmplt_ps(distance, queryWorst));
+
+			if(accepted == 0)
+				continue;
+
+			alignas(16) float distances[4];
+			_mm_store_ps(distances, distance);
+
+			for(int lane = 0; lane < lanes; lane++)
+			{
+				if(accepted & (1 << lane))
+				{
+					BatchQuery& query = queries[active[group + lane]];
+
+					query.AddPhoton(distances[lane], i);
+					worst[lane] = query.GetWorstDistance();
+				}
+			}
+
+			queryWorst = _mm_load_ps(worst);
+		}
 	}
 }
 
+void PhotonMap::KDTree::SearchChildBatch(NodePtr node, bool isChild1, bool withCloser, bool withFarther, BatchQuery* queries, const int* active, int activeCount) const
+{
+	const int idx = node->sub.divfeat;
+	int next[BATCH_SIZE];
+	bool isFar[BATCH_SIZE];
+	float savedDist[BATCH_SIZE], savedMindist[BATCH_SIZE];
+	int nextCount = 0;
+
+	for(int i = 0; i < activeCount; i++)
+	{
+		BatchQuery& query = queries[active[i]];
+		const float val = query.point[idx];
+		const bool isCloser = (((val - node->sub.divlow) + (val - node->sub.divhigh) < 0) == isChild1);
+
+		if(isCloser)
+		{
+			if(withCloser)
+			{
+				isFar[nextCount] = false;
+				next[nextCount++] = active[i];
+			}
+
+			continue;
+		}
+
+		if(!withFarther)
+			continue;
+
+		// as in searchLevel(), the farther child is only entered if it may hold a closer photon
+		const float cut = isChild1 ? (val - node->sub.divlow) : (val - node->sub.divhigh);
+		const float mindist = query.mindist + cut * cut - query.dists[idx];
+
+		if(mindist <= query.GetWorstDistance())
+		{
+			isFar[nextCount] = true;
+			savedDist[nextCount] = query.dists[idx];
+			savedMindist[nextCount] = query.mindist;
+			next[nextCount++] = active[i];
+
+			query.dists[idx] = cut * cut;
+			query.mindist = mindist;
+		}
+	}
+
+	if(nextCount == 0)
+		return;
+
+	SearchLevelBatch(isChild1 ? node->child1 : node->child2, queries, next, nextCount);
+
+	for(int i = 0; i < nextCount; i++)
+	{
+		if(isFar[i])
+		{
+			queries[next[i]].dists[idx] = savedDist[i];
+			queries[next[i]].mindist = savedMindist[i];
+		}
+	}
+}
+
+void PhotonMap::KDTree::SearchLevelBatch(NodePtr node, BatchQuery* queries, const int* active, int activeCount) const
+{
+	if((node->child1 == NULL) && (node->child2 == NULL))
+	{
+		SearchLeafBatch(node, queries, active, activeCount);
+		return;
+	}
+
+	const int idx = node->sub.divfeat;
+	int closerToChild1 = 0;
+
+	for(int i = 0; i < activeCount; i++)
+	{
+		const float val = queries[active[i]].point[idx];
+
+		if((val - node->sub.divlow) + (val - node->sub.divhigh) < 0)
+			closerToChild1++;
+	}
+
+	/*
+		Every query visits its closer child before the farther one, exactly like searchLevel(), so it
+		compares against the same photons as a single search. The child most queries are closer to
+		comes first, the others visit it last as their farther child.
+	*/
+	const bool child1First = (2 * closerToChild1 >= activeCount);
+
+	SearchChildBatch(node, child1First, true, false, queries, active, activeCount);
+	SearchChildBatch(node, !child1First, true, true, queries, active, activeCount);
+	SearchChildBatch(node, child1First, false, true, queries, active, activeCount);
+}
+
+void PhotonMap::KDTree::FindNeighborsBatch(BatchQuery* queries, int count) const
+{
+	if(!root_node) 
+		throw std::runtime_error("A photon map was searched before building it.");
+
+	int active[BATCH_SIZE];
+
+	// same as computeInitialDistances()
+	for(int i = 0; i < count; i++)
+	{
+		BatchQuery& query = queries[i];
+
+		query.mindist = 0;
+
+		for(int dim = 0; dim < 3; dim++)
+		{
+			const float val = query.point[dim];
+
+			query.dists[dim] = 0;
+
+			if(val < root_bbox[dim].low)
+				query.dists[dim] = (val - root_bbox[dim].low) * (val - root_bbox[dim].low);
+
+			if(val > root_bbox[dim].high)
+				query.dists[dim] = (val - root_bbox[dim].high) * (val - root_bbox[dim].high);
+
+			query.mindist += query.dists[dim];
+		}
+
+		active[i] = i;
+	}
+
+	if(count > 0)
+		SearchLevelBatch(root_node, queries, active, count);
+}
+
+void PhotonMap::Build(TaskPool& pool, int workerIndex)
+{
+	const int count = GetRegisteredPhotonCount();
+	const int grainSize = 64 * 1024;
+
+	positionX.resize(count);
+	positionY.resize(count);
+	positionZ.resize(count);
+
+	pool.ParallelFor(0, count, grainSize, [&](int worker, int begin, int end)
+	{
+		for(int i = begin; i < end; i++)
+		{
+			const Vector3 impact = registeredPhotons[i]->GetImpact();
+
+			positionX[i] = impact.x;
+			positionY[i] = impact.y;
+			positionZ[i] = impact.z;
+		}
+	}, workerIndex);
+
+	if(lookup == EPhotonLookup::Grid)
+	{
+		kdTree.reset();
+		BuildGrid(pool, workerIndex);
+		return;
+	}
+
+	gridBucketStart.clear();
+	kdTree = std::make_shared<KDTree>(*this);
+
+	if(count == 0)
+		return;
+
+	kdTree->BuildIndex(pool, workerIndex);
+
+	// move photons and positions into tree order, the tree then indexes them directly
+	std::vector<size_t>& indices = kdTree->GetIndices();
+	std::vector<PathSegment*> photons(count);
+	std::vector<float> x(count), y(count), z(count);
+
+	pool.ParallelFor(0, count, grainSize, [&](int worker, int begin, int end)
+	{
+		for(int i = begin; i < end; i++)
+		{
+			photons[i] = registeredPhotons[indices[i]];
+			x[i] = positionX[indices[i]];
+			y[i] = positionY[indices[i]];
+			z[i] = positionZ[indices[i]];
+			indices[i] = i;
+		}
+	}, workerIndex);
+
+	std::copy(photons.begin(), photons.end(), registeredPhotons.begin());
+	positionX.swap(x);
+	positionY.swap(y);
+	positionZ.swap(z);
+}
+
 void PhotonMap::Sample(Vector3 where, int sampleCount, PhotonMapSearch& result)
 {
 	const float _where[3] = {where.x, where.y, where.z};
 
+	if(lookup == EPhotonLookup::Grid)
+	{
+		SampleGrid(_where, sampleCount, result);
+		return;
+	}
+
+	PhotonMapSearch* results[] = { &result };
+
+	SampleBatch(&where, results, 1, sampleCount);
+}
+
+void PhotonMap::SampleUnbatched(Vector3 where, int sampleCount, PhotonMapSearch& result)
+{
+	const float _where[3] = {where.x, where.y, where.z};
+
+	if(lookup == EPhotonLookup::Grid)
+	{
+		SampleGrid(_where, sampleCount, result);
+		return;
+	}
+
 	result.Initialize(sampleCount);
 
-	kdTree->knnSearch(_where, sampleCount, result.indices.data(), result.distances.data());
+	nanoflann::KNNResultSet<float> resultSet(sampleCount);
+	resultSet.init(result.indices.data(), result.distances.data());
+	kdTree->findNeighbors(resultSet, _where, nanoflann::SearchParams());
+	result.count = resultSet.size();
+	result.visitedCount = resultSet.visited;
 
-	for(int i = 0; i < result.indices.size(); i++)
+	for(size_t i = 0; i < result.count; i++)
 	{
 		result.photons[i] = registeredPhotons[result.indices[i]];
 	}
 }
+
+void PhotonMap::SampleBatch(const Vector3* where, PhotonMapSearch* const* results, int count, int sampleCount)
+{
+	if(lookup == EPhotonLookup::Grid)
+	{
+		// a grid search only scans a few contiguous cells, there is no walk to share
+		for(int i = 0; i < count; i++)
+		{
+			Sample(where[i], sampleCount, *results[i]);
+		}
+
+		return;
+	}
+
+	BatchQuery queries[BATCH_SIZE];
+
+	for(int first = 0; first < count; first += BATCH_SIZE)
+	{
+		const int batchCount = std::min(BATCH_SIZE, count - first);
+
+		for(int i = 0; i < batchCount; i++)
+		{
+			PhotonMapSearch& result = *results[first + i];
+			BatchQuery& query = queries[i];
+
+			result.Initialize(sampleCount);
+
+			query.point[0] = where[first + i].x;
+			query.point[1] = where[first + i].y;
+			query.point[2] = where[first + i].z;
+			query.indices = result.indices.data();
+			query.distances = result.distances.data();
+			query.capacity = sampleCount;
+			query.count = 0;
+			query.visited = 0;
+		}
+
+		kdTree->FindNeighborsBatch(queries, batchCount);
+
+		for(int i = 0; i < batchCount; i++)
+		{
+			PhotonMapSearch& result = *results[first + i];
+
+			result.visitedCount = queries[i].visited;
+			result.count = queries[i].count;
+
+			for(int j = 0; j < result.count; j++)
+			{
+				result.photons[j] = registeredPhotons[result.indices[j]];
+			}
+		}
+	}
+}
+
+int PhotonMap::GetGridBucket(int x, int y, int z) const
+{
+	const uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+
+	return (int)(hash & (uint32_t)(gridBucketStart.size() - 2));
+}
+
+int PhotonMap::GetGridCellExtent(float extent) const
+{
+	// clamping only merges far apart cells, the cells around a query still contain all photons near it
+	const float MAX_CELL_EXTENT = (float)(1 << 20);
+
+	return (int)std::min(extent / gridCellSize, MAX_CELL_EXTENT) + 1;
+}
+
+void PhotonMap::GetGridCell(const float* where, int* outCell) const
+{
+	for(int i = 0; i < 3; i++)
+	{
+		// far away (or NaN) coordinates would overflow an int, anything outside the photons' bounds is one cell off them
+		const float cell = std::floor((where[i] - gridOrigin[i]) / gridCellSize);
+
+		outCell[i] = (int)std::max(-1.0f, std::min(cell, (float)gridCellExtent));
+	}
+}
+
+void PhotonMap::BuildGrid(TaskPool& pool, int workerIndex)
+{
+	const int PHOTONS_PER_CELL = 32;
+	const int count = GetRegisteredPhotonCount();
+	const int grainSize = 64 * 1024;
+
+	// twice as many buckets as expected cells keeps collisions rare
+	int bucketCount = 1;
+	while(bucketCount < 2 * count / PHOTONS_PER_CELL) bucketCount *= 2;
+
+	gridBucketStart.assign(bucketCount + 1, 0);
+
+	if(count == 0)
+		return;
+
+	float high[3];
+	for(int i = 0; i < 3; i++)
+	{
+		const std::vector<float>& position = (i == 0) ? positionX : ((i == 1) ? positionY : positionZ);
+		const auto bounds = std::minmax_element(position.begin(), position.end());
+
+		gridOrigin[i] = *bounds.first;
+		high[i] = *bounds.second;
+	}
+
+	const float extent = std::max(high[0] - gridOrigin[0], std::max(high[1] - gridOrigin[1], high[2] - gridOrigin[2]));
+
+	/*
+		Start as if the photons filled a cube, then correct by the cells actually occupied. Photons
+		sit on surfaces, so the photons per occupied cell grow with the square of the cell size.
+	*/
+	std::vector<int> buckets(count);
+	gridCellSize = std::max(1e-6f, extent / std::cbrt(std::max(1.0f, (float)count / PHOTONS_PER_CELL)));
+
+	for(int iteration = 0; ; iteration++)
+	{
+		gridCellExtent = GetGridCellExtent(extent);
+
+		pool.ParallelFor(0, count, grainSize, [&](int worker, int begin, int end)
+		{
+			for(int i = begin; i < end; i++)
+			{
+				const float where[3] = { positionX[i], positionY[i], positionZ[i] };
+				int cell[3];
+
+				GetGridCell(where, cell);
+				buckets[i] = GetGridBucket(cell[0], cell[1], cell[2]);
+			}
+		}, workerIndex);
+
+		std::fill(gridBucketStart.begin(), gridBucketStart.end(), 0);
+
+		for(int i = 0; i < count; i++) gridBucketStart[buckets[i] + 1]++;
+
+		if(iteration == 3)
+			break;
+
+		// linear counting, the number of distinct cells from the number of empty buckets
+		const int emptyBuckets = (int)std::count(gridBucketStart.begin() + 1, gridBucketStart.end(), 0);
+		const double occupiedCells = (emptyBuckets > 0) ? -bucketCount * std::log(emptyBuckets / (double)bucketCount) : bucketCount;
+		const double scale = std::sqrt(PHOTONS_PER_CELL * std::max(1.0, occupiedCells) / count);
+
+		if(std::abs(scale - 1) < 0.1)
+			break;
+
+		gridCellSize = std::max(1e-6f, gridCellSize * (float)Math::Clamp(scale, 0.125, 8.0));
+	}
+
+	// stable counting sort by bucket, so each bucket's photons and positions are contiguous
+	for(int i = 0; i < bucketCount; i++) gridBucketStart[i + 1] += gridBucketStart[i];
+
+	std::vector<int> cursor(gridBucketStart.begin(), gridBucketStart.end() - 1);
+	std::vector<PathSegment*> photons(count);
+	std::vector<float> x(count), y(count), z(count);
+
+	for(int i = 0; i < count; i++)
+	{
+		const int target = cursor[buckets[i]]++;
+
+		photons[target] = registeredPhotons[i];
+		x[target] = positionX[i];
+		y[target] = positionY[i];
+		z[target] = positionZ[i];
+	}
+
+	std::copy(photons.begin(), photons.end(), registeredPhotons.begin());
+	positionX.swap(x);
+	positionY.swap(y);
+	positionZ.swap(z);
+}
+
+bool PhotonMap::GatherGrid(const float* where, int ring, PhotonMapSearch& result) const
+{
+	const int bucketCount = (int)gridBucketStart.size() - 1;
+	const int64_t cellCount = (int64_t)(2 * ring + 1) * (2 * ring + 1) * (2 * ring + 1);
+	const size_t visitedBuckets = result.buckets.size();
+	int cell[3];
+
+	GetGridCell(where, cell);
+
+	// does the cube of cells around "where" contain all photons?
+	bool isComplete = true;
+	for(int i = 0; i < 3; i++)
+	{
+		isComplete &= (cell[i] - ring <= 0) && (cell[i] + ring >= gridCellExtent);
+	}
+
+	if(cellCount >= bucketCount)
+	{
+		// hashing more cells than there are buckets is slower than taking the remaining buckets in order
+		size_t visited = 0;
+		for(int i = 0; i < bucketCount; i++)
+		{
+			while((visited < visitedBuckets) && (result.buckets[visited] < i)) visited++;
+
+			if((visited == visitedBuckets) || (result.buckets[visited] != i))
+				result.buckets.push_back(i);
+		}
+
+		isComplete = true;
+	}
+	else
+	{
+		// only the shell added by this ring, the smaller rings have been gathered already
+		const int inner = (ring == 1) ? 0 : ring;
+
+		for(int z = -ring; z <= ring; z++)
+		{
+			for(int y = -ring; y <= ring; y++)
+			{
+				const bool isFace = (std::abs(z) >= inner) || (std::abs(y) >= inner);
+
+				for(int x = -ring; x <= ring; x += (isFace ? 1 : 2 * ring))
+				{
+					result.buckets.push_back(GetGridBucket(cell[0] + x, cell[1] + y, cell[2] + z));
+				}
+			}
+		}
+
+		// neighboring cells may share a bucket, whose photons must only be gathered once
+		const auto added = result.buckets.begin() + visitedBuckets;
+
+		std::sort(added, result.buckets.end());
+		result.buckets.erase(std::unique(added, result.buckets.end()), result.buckets.end());
+		result.buckets.erase(std::remove_if(added, result.buckets.end(), [&](int bucket)
+		{
+			return std::binary_search(result.buckets.begin(), result.buckets.begin() + visitedBuckets, bucket);
+		}), result.buckets.end());
+	}
+
+	for(size_t k = visitedBuckets; k < result.buckets.size(); k++)
+	{
+		const int begin = gridBucketStart[result.buckets[k]], end = gridBucketStart[result.buckets[k] + 1];
+
+		for(int i = begin; i < end; i++)
+		{
+			const float d0 = where[0] - positionX[i];
+			const float d1 = where[1] - positionY[i];
+			const float d2 = where[2] - positionZ[i];
+
+			result.candidates.push_back(std::make_pair(d0*d0+d1*d1+d2*d2, i));
+		}
+
+		result.visitedCount += end - begin;
+	}
+
+	std::inplace_merge(result.buckets.begin(), result.buckets.begin() + visitedBuckets, result.buckets.end());
+
+	return isComplete;
+}
+
+void PhotonMap::SampleGrid(const float* where, int sampleCount, PhotonMapSearch& result) const
+{
+	result.buckets.clear();
+	result.candidates.clear();
+	result.visitedCount = 0;
+
+	if(gridBucketStart.empty() || (gridBucketStart.back() == 0))
+	{
+		result.Initialize(0);
+		return;
+	}
+
+	/*
+		The 27 cells around "where" cover the gather radius, more only if they hold no photon
+		within it. Each ring gathers its shell of cells, candidates beyond the radius of the
+		final ring are dropped. Once the cube covers all photons the radius is dropped as well,
+		so a search never comes back empty.
+	*/
+	float maxDistance = std::numeric_limits<float>::infinity();
+	float nearest = std::numeric_limits<float>::infinity();
+
+	for(int ring = 1; ; ring++)
+	{
+		const size_t gathered = result.candidates.size();
+
+		if(GatherGrid(where, ring, result))
+		{
+			maxDistance = std::numeric_limits<float>::infinity();
+			break;
+		}
+
+		// a photon gathered by a smaller ring lay beyond that ring's radius, but may lie within this one
+		for(size_t i = gathered; i < result.candidates.size(); i++) nearest = std::min(nearest, result.candidates[i].first);
+
+		const float radius = ring * gridCellSize;
+		maxDistance = radius * radius;
+
+		if(nearest <= maxDistance)
+			break;
+	}
+
+	result.candidates.erase(std::remove_if(result.candidates.begin(), result.candidates.end(), [&](const std::pair<float, int>& candidate)
+	{
+		return candidate.first > maxDistance;
+	}), result.candidates.end());
+
+	const int count = std::min(sampleCount, (int)result.candidates.size());
+
+	if(count < (int)result.candidates.size())
+		std::nth_element(result.candidates.begin(), result.candidates.begin() + count, result.candidates.end());
+
+	result.Initialize(count);
+
+	for(int i = 0; i < count; i++)
+	{
+		result.indices[i] = result.candidates[i].second;
+		result.distances[i] = result.candidates[i].first;
+		result.photons[i] = registeredPhotons[result.candidates[i].second];
+	}
+
+	result.count = count;
+}
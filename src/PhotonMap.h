@@ -26,37 +26,122 @@ private:
 	std::vector<size_t> indices;
 	std::vector<float> distances;
 	std::vector<PathSegment*> photons;
+	size_t count;
+	size_t visitedCount;
 
+	// scratch memory of the grid lookup, see PhotonMap::SampleGrid()
+	std::vector<int> buckets;
+	std::vector<std::pair<float, int>> candidates;
+
+	/*
+		Makes room for "maxSamples" results. The buffers only ever grow, so a search neither
+		reallocates nor clears them, the results being their first "count" entries.
+	*/
 	void Initialize(int maxSamples) 
 	{
-		indices.clear();
-		distances.clear();
-		photons.clear();
-
-		indices.resize(maxSamples);
-		distances.resize(maxSamples);
-		photons.resize(maxSamples);
+		if(photons.size() < (size_t)maxSamples)
+		{
+			indices.resize(maxSamples);
+			distances.resize(maxSamples);
+			photons.resize(maxSamples);
+		}
+
+		count = 0;
 	}
 public:
-	PhotonMapSearch() : indices(), distances(), photons() 
+	PhotonMapSearch() : indices(), distances(), photons(), count(0), visitedCount(0), buckets(), candidates()
 	{ 
 	}
 
-	std::vector<PathSegment*>::const_iterator begin() { return photons.cbegin(); }
-	std::vector<PathSegment*>::const_iterator end() { return photons.cend(); }
-	PathSegment* Select() const { return photons[std::rand() % photons.size()]; }
+	/** Number of photons found by the last search. */
+	size_t GetCount() const { return count; }
+
+	/** Number of photons the last search compared against the query point. */
+	size_t GetVisitedCount() const { return visitedCount; }
+
+	std::vector<PathSegment*>::const_iterator begin() const { return photons.cbegin(); }
+	std::vector<PathSegment*>::const_iterator end() const { return photons.cbegin() + count; }
+	PathSegment* Select(RandomGenerator& random) const { return photons[random.NextInt((int)count)]; }
+};
+
+/**
+	Spatial index a PhotonMap is searched with.
+*/
+enum class EPhotonLookup
+{
+	/** Exact k nearest neighbors. */
+	KDTree,
+	/** k nearest neighbors within a fixed radius, gathered from a hashed uniform grid. */
+	Grid,
 };
 
 /**
-	A photon map provides the backing memory as well as a KD-tree based nearest neighbor
+	A photon map provides the backing memory as well as a KD-tree or grid based nearest neighbor
 	search for PathSegments ("photons"). 
 */
 class PhotonMap : boost::noncopyable
 {
 private:
 	typedef nanoflann::L2_Simple_Adaptor<float, PhotonMap> Metric;
-	typedef nanoflann::KDTreeSingleIndexAdaptor<Metric, PhotonMap, 3> KDTree;
-	friend KDTree;
+	typedef nanoflann::KDTreeSingleIndexAdaptor<Metric, PhotonMap, 3> KDTreeBase;
+
+	/** Most queries walking the KD-tree together in SampleBatch(). */
+	static const int BATCH_SIZE = 16;
+
+	/*
+		One query of SampleBatch(), its walk state corresponds to the arguments of KDTreeBase::searchLevel().
+		The photons found so far are a max-heap on their distance, so adding one of "capacity" many costs
+		O(log capacity) instead of shifting the sorted entries of a nanoflann::KNNResultSet.
+	*/
+	struct BatchQuery
+	{
+		float point[3];
+		float dists[3];
+		float mindist;
+		size_t* indices;
+		float* distances;
+		int capacity;
+		int count;
+		size_t visited;
+
+		float GetWorstDistance() const { return (count < capacity) ? std::numeric_limits<float>::max() : distances[0]; }
+		void AddPhoton(float distance, size_t index);
+	};
+
+	class KDTree : public KDTreeBase
+	{
+	private:
+		// node memory of subtrees built by other tasks, the base class' pool is not thread safe
+		std::vector<std::unique_ptr<nanoflann::PooledAllocator>> allocators;
+		std::mutex allocatorMutex;
+
+		nanoflann::PooledAllocator& AddAllocator();
+		NodePtr DivideTree(TaskPool& pool, int workerIndex, nanoflann::PooledAllocator& allocator, size_t left, size_t right, BoundingBox& bbox);
+		void SearchLevelBatch(NodePtr node, BatchQuery* queries, const int* active, int activeCount) const;
+		void SearchChildBatch(NodePtr node, bool isChild1, bool withCloser, bool withFarther, BatchQuery* queries, const int* active, int activeCount) const;
+		void SearchLeafBatch(NodePtr node, BatchQuery* queries, const int* active, int activeCount) const;
+
+	public:
+		KDTree(const PhotonMap& map) : KDTreeBase(3, map, nanoflann::KDTreeSingleIndexAdaptorParams(10)) { }
+
+		/**
+			Builds the same tree as buildIndex(), but subtrees above a size threshold are
+			built as tasks on "pool". "workerIndex" is the calling worker, if any.
+		*/
+		void BuildIndex(TaskPool& pool, int workerIndex);
+
+		/**
+			Finds the same neighbors as findNeighbors() for each of the "count" <= BATCH_SIZE
+			queries, but walks the tree once for all of them. Only works after Build() has put
+			the points into tree order.
+		*/
+		void FindNeighborsBatch(BatchQuery* queries, int count) const;
+
+		/** Point indices in tree order, the points of a leaf being consecutive. */
+		std::vector<size_t>& GetIndices() { return vind; }
+	};
+
+	friend KDTreeBase;
 	friend Metric;
 
 	std::shared_ptr<KDTree> kdTree;
@@ -67,6 +152,32 @@ private:
 	std::atomic<int> photonRegisterIndex;
 	std::vector<PathSegment*> registeredPhotons;
 
+	/*
+		Impact points of the registered photons, one array per axis. After Build() they and
+		"registeredPhotons" are in tree order, so the distance tests of a leaf scan contiguous
+		memory and a PathSegment is only touched for the final search results.
+	*/
+	std::vector<float> positionX, positionY, positionZ;
+
+	EPhotonLookup lookup;
+
+	/*
+		Hashed uniform grid, only built for EPhotonLookup::Grid. The registered photons and
+		their positions are sorted by bucket instead of tree order, the photons of bucket "i"
+		being [gridBucketStart[i], gridBucketStart[i + 1]). The bucket count is a power of two.
+	*/
+	std::vector<int> gridBucketStart;
+	float gridOrigin[3];
+	float gridCellSize;
+	int gridCellExtent;
+
+	int GetGridBucket(int x, int y, int z) const;
+	int GetGridCellExtent(float extent) const;
+	void GetGridCell(const float* where, int* outCell) const;
+	void BuildGrid(TaskPool& pool, int workerIndex);
+	bool GatherGrid(const float* where, int ring, PhotonMapSearch& result) const;
+	void SampleGrid(const float* where, int sampleCount, PhotonMapSearch& result) const;
+
 	inline size_t kdtree_get_point_count() const { return photonRegisterIndex; }
 
 	float kdtree_distance(const float* p1, const size_t idx_p2, size_t size) const;
@@ -95,19 +206,41 @@ public:
 	*/
 	bool HasFreeSpace() const { return photonStorageIndex < totalPhotonCount; }
 
+	EPhotonLookup GetLookup() const { return lookup; }
+	/** Takes effect with the next call to Build(). */
+	void SetLookup(EPhotonLookup value) { lookup = value; }
+
 	/**
-		Build the KD-tree from all allocated & registered photons we have so far.
+		Build the KD-tree or grid from all allocated & registered photons we have so far.
 		All photons allocated/registered afterwards are not entered into the KD-tree!
+		The work is split into tasks on "pool", "workerIndex" is the calling worker, if any.
 	*/
-	void Build();
+	void Build(TaskPool& pool, int workerIndex = -1);
 
 	/**
 		Only works after Build() has been called. Will sample exactly "sampleCount" many
 		photons in the proximity of "where" (unless there are fewer photons in the map
 		than requested!). 
+
+		The grid lookup only returns the nearest photons within one cell edge of "where",
+		which may be fewer than "sampleCount". Only if there is none, the search widens
+		until at least one photon is found.
 	*/
 	void Sample(Vector3 where, int sampleCount, PhotonMapSearch& result);
 
+	/**
+		Same as Sample() for "count" query points, "where[i]" being searched into "*results[i]".
+		Consecutive queries should be close to each other, as they share the walk through the
+		KD-tree in groups and leaf photons are tested against four of them per SSE instruction.
+	*/
+	void SampleBatch(const Vector3* where, PhotonMapSearch* const* results, int count, int sampleCount);
+
+	/**
+		Same as Sample() through nanoflann's own single query search, which SampleBatch() has
+		replaced. Much slower, it is only kept to verify the batched walk against.
+	*/
+	void SampleUnbatched(Vector3 where, int sampleCount, PhotonMapSearch& result);
+
 	std::vector<PathSegment>::const_iterator begin() const { return photonStorage.cbegin(); }
 	std::vector<PathSegment>::const_iterator end() const { return photonStorage.cend(); }
 };
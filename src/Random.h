@@ -0,0 +1,154 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef _RANDOM_H_
+#define _RANDOM_H_
+
+#include <stdint.h>
+
+/*
+	Independent random streams. Together with the remaining seed parameters they form
+	the key of a RandomGenerator, so two different streams never produce correlated numbers.
+*/
+enum class ERandomStream : uint32_t
+{
+	Thread = 0,
+	ScreenDirect = 1,
+	ScreenIndirect = 2,
+	Photon = 3,
+	Sampler = 4,
+};
+
+/*
+	Counter-based random number generator (Philox4x32-10, see Salmon et al., "Parallel
+	Random Numbers: As Easy as 1, 2, 3").
+
+	Every random number is a pure function of (stream, index, pass, sample, counter), so
+	there is no shared state between threads and a pixel always sees the same numbers,
+	no matter which thread renders it or how many threads there are. Each ThreadContext owns
+	one instance, which is reseeded whenever a new unit of work (pixel pass, photon batch) starts.
+*/
+class RandomGenerator
+{
+private:
+	uint32_t key[2];
+	uint32_t counter[4];
+	uint32_t block[4];
+	int blockIndex;
+
+	static uint32_t MulHiLo(uint32_t a, uint32_t b, uint32_t* hi)
+	{
+		uint64_t product = (uint64_t)a * (uint64_t)b;
+		*hi = (uint32_t)(product >> 32);
+		return (uint32_t)product;
+	}
+
+	void GenerateBlock()
+	{
+		uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+		uint32_t k0 = key[0], k1 = key[1];
+
+		for(int round = 0; round < 10; round++)
+		{
+			uint32_t hi0, hi1;
+			uint32_t lo0 = MulHiLo(0xD2511F53, c0, &hi0);
+			uint32_t lo1 = MulHiLo(0xCD9E8D57, c2, &hi1);
+
+			c0 = hi1 ^ c1 ^ k0;
+			c1 = lo1;
+			c2 = hi0 ^ c3 ^ k1;
+			c3 = lo0;
+
+			k0 += 0x9E3779B9;
+			k1 += 0xBB67AE85;
+		}
+
+		block[0] = c0; block[1] = c1; block[2] = c2; block[3] = c3;
+		blockIndex = 0;
+
+		// advance 64-bit block counter
+		if(++counter[2] == 0)
+			counter[3]++;
+	}
+
+public:
+	RandomGenerator() { Seed(ERandomStream::Thread, 0, 0); }
+	explicit RandomGenerator(uint32_t seed) { Seed(ERandomStream::Thread, seed, 0); }
+
+	/*
+		Restarts the generator at the beginning of the sequence identified by the given
+		parameters. For screen sampling, "index" is the linear pixel index, for photon
+		tracing it is the light index and "pass" the photon batch.
+	*/
+	void Seed(ERandomStream stream, uint32_t index, uint32_t pass, uint32_t sample = 0)
+	{
+		key[0] = index;
+		key[1] = (uint32_t)stream;
+		counter[0] = pass;
+		counter[1] = sample;
+		counter[2] = 0;
+		counter[3] = 0;
+		blockIndex = 4;
+	}
+
+	uint32_t NextUInt()
+	{
+		if(blockIndex >= 4)
+			GenerateBlock();
+
+		return block[blockIndex++];
+	}
+
+	/** Uniformly distributed in [0, 1). */
+	float NextFloat()
+	{
+		// 24 random bits are exactly what a float mantissa can represent
+		return (NextUInt() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	/** Uniformly distributed in [0, maxExclusive), for "maxExclusive" > 0. */
+	int NextInt(int maxExclusive)
+	{
+		return (int)(((uint64_t)NextUInt() * (uint64_t)maxExclusive) >> 32);
+	}
+
+	/** Fills "out" with "count" uniformly distributed floats in [0, 1). */
+	void NextFloats(float* out, int count)
+	{
+		int i = 0;
+
+		// drain current block first, then work on whole blocks
+		for(; (i < count) && (blockIndex < 4); i++)
+			out[i] = NextFloat();
+
+		for(; i + 4 <= count; i += 4)
+		{
+			GenerateBlock();
+
+			out[i + 0] = (block[0] >> 8) * (1.0f / 16777216.0f);
+			out[i + 1] = (block[1] >> 8) * (1.0f / 16777216.0f);
+			out[i + 2] = (block[2] >> 8) * (1.0f / 16777216.0f);
+			out[i + 3] = (block[3] >> 8) * (1.0f / 16777216.0f);
+			blockIndex = 4;
+		}
+
+		for(; i < count; i++)
+			out[i] = NextFloat();
+	}
+};
+
+#endif
@@ -17,45 +17,566 @@
 
 #include "stdafx.h"
 
+/*
+	Top level of the two-level hierarchy, a binary BVH over placed instances. Each instance refers
+	to the object space intersector of its prototype, rays are moved into object space on the fly.
+	Transforms are affine and directions are not renormalized, so hit distances stay world space.
+*/
+class InstanceIntersector : public embree::Intersector
+{
+public:
+	struct Instance
+	{
+		embree::Ref<embree::Intersector> intersector;
+		embree::AffineSpace3f worldToObject;
+		embree::BBox3f bounds;
+		int firstTriangle; // global index of the first triangle, object space hits are offset by this
+		int triangleCount;
+		bool isIdentity;
+	};
+
+private:
+	struct Node
+	{
+		embree::BBox3f bounds;
+		int children[2];
+		int first; // first instance of a leaf
+		int count; // instances in a leaf, zero for inner nodes
+	};
+
+	std::vector<Instance> instances;
+	std::vector<Node> nodes;
+
+	int BuildNode(int begin, int end)
+	{
+		embree::BBox3f bounds(embree::empty), centroids(embree::empty);
+		const int index = (int)nodes.size();
+
+		for(int i = begin; i < end; i++)
+		{
+			bounds = embree::merge(bounds, instances[i].bounds);
+			centroids = embree::merge(centroids, embree::center(instances[i].bounds));
+		}
+
+		nodes.push_back(Node());
+		nodes[index].bounds = bounds;
+		nodes[index].first = begin;
+		nodes[index].count = end - begin;
+
+		if(end - begin <= 2)
+			return index;
+
+		// median split along the largest extent of the centroids
+		const Vector3 extent = embree::size(centroids);
+		const int axis = (extent.x >= extent.y) ? ((extent.x >= extent.z) ? 0 : 2) : ((extent.y >= extent.z) ? 1 : 2);
+		const int middle = (begin + end) / 2;
+
+		std::nth_element(instances.begin() + begin, instances.begin() + middle, instances.begin() + end, [axis](const Instance& a, const Instance& b)
+		{
+			return embree::center(a.bounds)[axis] < embree::center(b.bounds)[axis];
+		});
+
+		const int left = BuildNode(begin, middle);
+		const int right = BuildNode(middle, end);
+
+		nodes[index].children[0] = left;
+		nodes[index].children[1] = right;
+		nodes[index].count = 0;
+
+		return index;
+	}
+
+	static bool IntersectsBox(const Ray& ray, const embree::BBox3f& box, float far)
+	{
+		const Vector3 t0 = (box.lower - ray.org) * ray.rdir;
+		const Vector3 t1 = (box.upper - ray.org) * ray.rdir;
+		const float tNear = std::max(embree::reduce_max(embree::min(t0, t1)), ray.near);
+		const float tFar = std::min(embree::reduce_min(embree::max(t0, t1)), far);
+
+		return tNear <= tFar;
+	}
+
+	static Ray ToObjectSpace(const Instance& instance, const Ray& ray)
+	{
+		// the excluded triangle only exists in object space if it belongs to this instance
+		const int localId = ray.excludeId - instance.firstTriangle;
+		const int excludeId = ((localId >= 0) && (localId < instance.triangleCount)) ? localId : -1;
+
+		if(instance.isIdentity)
+			return Ray(ray.org, ray.dir, ray.near, ray.far, ray.time, excludeId);
+
+		return Ray(
+			embree::xfmPoint(instance.worldToObject, ray.org), 
+			embree::xfmVector(instance.worldToObject, ray.dir), 
+			ray.near, ray.far, ray.time, excludeId);
+	}
+
+public:
+	InstanceIntersector(std::vector<Instance> instances) : instances(std::move(instances))
+	{
+		if(!this->instances.empty())
+			BuildNode(0, (int)this->instances.size());
+	}
+
+	size_t GetInstanceCount() const { return instances.size(); }
+	size_t GetBytes() const { return nodes.size() * sizeof(Node) + instances.size() * sizeof(Instance); }
+
+	virtual void intersect(const Ray& ray, embree::Hit& hit) const
+	{
+		int stack[64], stackSize = 0;
+
+		if(!nodes.empty())
+			stack[stackSize++] = 0;
+
+		while(stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+
+			if(!IntersectsBox(ray, node.bounds, std::min(ray.far, hit.t)))
+				continue;
+
+			if(node.count == 0)
+			{
+				stack[stackSize++] = node.children[1];
+				stack[stackSize++] = node.children[0];
+				continue;
+			}
+
+			for(int i = node.first; i < node.first + node.count; i++)
+			{
+				const Instance& instance = instances[i];
+				embree::Hit local;
+
+				local.t = hit.t;
+				instance.intersector->intersect(ToObjectSpace(instance, ray), local);
+
+				if(local)
+				{
+					hit = local;
+					hit.id0 += instance.firstTriangle;
+				}
+			}
+		}
+	}
+
+	virtual bool occluded(const Ray& ray) const
+	{
+		int stack[64], stackSize = 0;
+
+		if(!nodes.empty())
+			stack[stackSize++] = 0;
+
+		while(stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+
+			if(!IntersectsBox(ray, node.bounds, ray.far))
+				continue;
+
+			if(node.count == 0)
+			{
+				stack[stackSize++] = node.children[1];
+				stack[stackSize++] = node.children[0];
+				continue;
+			}
+
+			for(int i = node.first; i < node.first + node.count; i++)
+			{
+				if(instances[i].intersector->occluded(ToObjectSpace(instances[i], ray)))
+					return true;
+			}
+		}
+
+		return false;
+	}
+};
+
 struct RayIntersector_Impl
 {
-	embree::Ref<embree::Accel> accel;
+	// one accel for a flat scene, otherwise one per instanced prototype plus one for the remaining triangles
+	std::vector<embree::Ref<embree::Accel>> accels;
+	embree::Ref<InstanceIntersector> instances;
 	embree::Ref<embree::Intersector> intersector;
+	double prepareSeconds;
+	int cachedAccels;
+
+	RayIntersector_Impl() : prepareSeconds(0), cachedAccels(0) { }
+};
+
+/*
+	Runs embree's BVH builders on the tracer's task pool instead of embree's own scheduler
+	threads. Every work item of an embree task becomes one pool task, the last one to finish
+	runs the completion function (which in turn may add more tasks to the same group).
+*/
+class PoolTaskScheduler : public embree::TaskScheduler
+{
+private:
+	struct TaskSet
+	{
+		std::atomic<size_t> remaining;
+		runFunction run;
+		void* runData;
+		completeFunction complete;
+		void* completeData;
+	};
+
+	TaskPool& pool;
+	TaskGroup group;
+
+public:
+	PoolTaskScheduler(TaskPool& pool) : pool(pool) { }
+
+	virtual size_t getNumThreads() const { return pool.GetThreadCount(); }
+
+	virtual void start() { }
+
+	virtual void stop() { pool.Wait(group); }
+
+	virtual void addTask(const ThreadInfo& thread, QUEUE queue,
+						 runFunction run, void* runData, size_t elts = 1, 
+						 completeFunction complete = NULL, void* completeData = NULL, 
+						 const char* name = NULL)
+	{
+		// "queue" is ignored, workers process their own deque depth first anyway
+		auto set = std::make_shared<TaskSet>();
+
+		set->remaining = elts;
+		set->run = run;
+		set->runData = runData;
+		set->complete = complete;
+		set->completeData = completeData;
+
+		for(size_t elt = 0; elt < elts; elt++)
+		{
+			pool.Submit(group, [set, elt](int workerIndex)
+			{
+				ThreadInfo info(workerIndex);
+
+				if(set->run)
+					set->run(info, set->runData, elt);
+
+				if((--set->remaining == 0) && set->complete)
+					set->complete(info, set->completeData);
+			}, (int)thread.id);
+		}
+	}
 };
 
 
+static embree::AffineSpace3f ToAffineSpace(const Matrix4x4& m)
+{
+	return embree::AffineSpace3f(
+		embree::LinearSpace3f(
+			Vector3(m.getElem(0, 0), m.getElem(0, 1), m.getElem(0, 2)),
+			Vector3(m.getElem(1, 0), m.getElem(1, 1), m.getElem(1, 2)),
+			Vector3(m.getElem(2, 0), m.getElem(2, 1), m.getElem(2, 2))),
+		Vector3(m.getElem(3, 0), m.getElem(3, 1), m.getElem(3, 2)));
+}
+
+/*
+	Hashes the builder input with 64 bit FNV-1a over 32 bit words. Fixed size blocks of both arrays are hashed
+	on the task pool and their hashes are combined in order, so the key does not depend on the thread count.
+*/
+static uint64_t HashBuildInput(TaskPool& pool, const embree::BuildTriangle* tris, int count, const embree::BuildVertex* verts, int vertexCount)
+{
+	const size_t blockBytes = 1024 * 1024;
+	std::vector<std::pair<const char*, size_t>> blocks;
+
+	auto addBlocks = [&](const void* data, size_t bytes)
+	{
+		for(size_t offset = 0; offset < bytes; offset += blockBytes)
+		{
+			blocks.push_back(std::make_pair((const char*)data + offset, std::min(blockBytes, bytes - offset)));
+		}
+	};
+
+	auto hashWords = [](uint64_t hash, const void* data, size_t bytes)
+	{
+		const uint32_t* words = (const uint32_t*)data;
+
+		for(size_t i = 0; i < bytes / sizeof(uint32_t); i++)
+		{
+			hash = (hash ^ words[i]) * 1099511628211ULL;
+		}
+
+		return hash;
+	};
+
+	addBlocks(tris, count * sizeof(embree::BuildTriangle));
+	addBlocks(verts, vertexCount * sizeof(embree::BuildVertex));
+
+	std::vector<uint64_t> blockHashes(blocks.size());
+
+	pool.ParallelFor(0, (int)blocks.size(), 1, [&](int workerIndex, int begin, int end)
+	{
+		for(int block = begin; block < end; block++)
+		{
+			blockHashes[block] = hashWords(14695981039346656037ULL, blocks[block].first, blocks[block].second);
+		}
+	});
+
+	uint64_t hash = hashWords(14695981039346656037ULL, &count, sizeof(count));
+
+	hash = hashWords(hash, &vertexCount, sizeof(vertexCount));
+
+	return hashWords(hash, blockHashes.data(), blockHashes.size() * sizeof(uint64_t));
+}
+
+/*
+	Builds one embree accel over "count" triangles, "triangleAt(i)" returning the i-th one. Uses "ids"
+	as their id0 (defaults to 0..count-1). Every mesh contributes its vertices once and the embree
+	triangles index into them, just like the mesh's own triangles do. The vertex copy and embree's
+	primitive reference generation and build all run on the tracer's task pool, "prepareSeconds"
+	accumulates the time of the copy and cache lookup. Unless "cacheFile" is empty, the accel is loaded
+	from there if it was built over the same input and written there otherwise, "cachedAccels" counts
+	the ones loaded.
+*/
+template<class TTriangleAt>
+static embree::Ref<embree::Accel> BuildAccel(RayTracer* tracer, int count, TTriangleAt triangleAt, const int* ids, const std::string& cacheFile, double& prepareSeconds, int& cachedAccels)
+{
+	StopWatch watch;
+
+	// triangles of a mesh are consecutive, every run of them gets the mesh's vertices appended to the pool
+	struct MeshRun { const Mesh* mesh; int firstTriangle; int firstVertex; };
+	std::vector<MeshRun> runs;
+	int vertexCount = 0;
+
+	for(int i = 0; i < count; i++)
+	{
+		const Mesh* mesh = triangleAt(i).GetMesh();
+
+		if(runs.empty() || (runs.back().mesh != mesh))
+		{
+			MeshRun run = { mesh, i, vertexCount };
+
+			runs.push_back(run);
+			vertexCount += mesh->GetVertexCount();
+		}
+	}
+
+	embree::BuildTriangle* embreeTri = (embree::BuildTriangle*)embree::rtcMalloc(count * sizeof(embree::BuildTriangle));
+	embree::BuildVertex* embreeVert = (embree::BuildVertex*)embree::rtcMalloc(vertexCount * sizeof(embree::BuildVertex));
+
+	// chunks of both arrays are written independently, each starting with a lookup of its run
+	tracer->GetTaskPool().ParallelFor(0, vertexCount, 16 * 1024, [&](int workerIndex, int begin, int end)
+	{
+		auto run = std::upper_bound(runs.begin(), runs.end(), begin, [](int vertex, const MeshRun& r) { return vertex < r.firstVertex; }) - 1;
+
+		for(int i = begin; i < end; i++)
+		{
+			while((run + 1 != runs.end()) && (i >= (run + 1)->firstVertex))
+				++run;
+
+			auto p = run->mesh->GetVertexPosition(i - run->firstVertex);
+			embreeVert[i] = embree::BuildVertex(p.x, p.y, p.z);
+		}
+	});
+
+	tracer->GetTaskPool().ParallelFor(0, count, 16 * 1024, [&](int workerIndex, int begin, int end)
+	{
+		auto run = std::upper_bound(runs.begin(), runs.end(), begin, [](int triangle, const MeshRun& r) { return triangle < r.firstTriangle; }) - 1;
+
+		for(int i = begin; i < end; i++)
+		{
+			while((run + 1 != runs.end()) && (i >= (run + 1)->firstTriangle))
+				++run;
+
+			const Triangle& input = triangleAt(i);
+			embree::BuildTriangle& tri = embreeTri[i];
+
+			tri.id0 = ids ? ids[i] : i;
+			tri.id1 = 0;
+			tri.v0 = run->firstVertex + input.GetVertexIndexA();
+			tri.v1 = run->firstVertex + input.GetVertexIndexB();
+			tri.v2 = run->firstVertex + input.GetVertexIndexC();
+		}
+	});
+
+	const char* accelType = tracer->GetSettings().accel.c_str();
+	const char* triangleLayout = tracer->GetSettings().triangleLayout.c_str();
+	const uint64_t key = cacheFile.empty() ? 0 : HashBuildInput(tracer->GetTaskPool(), embreeTri, count, embreeVert, vertexCount);
+	embree::Ref<embree::Accel> accel;
+
+	if(!cacheFile.empty())
+		accel = embree::rtcLoadAccel(cacheFile.c_str(), accelType, triangleLayout, key);
+
+	prepareSeconds += std::chrono::duration<double>(watch.GetElapsed()).count();
+
+	if(accel)
+	{
+		embree::alignedFree(embreeTri);
+		embree::alignedFree(embreeVert);
+		cachedAccels++;
+
+		return accel;
+	}
+
+	// build on the tracer's task pool, embree only offers a global scheduler to hook into
+	embree::TaskScheduler* defaultScheduler = embree::scheduler;
+	PoolTaskScheduler poolScheduler(tracer->GetTaskPool());
+
+	embree::scheduler = &poolScheduler;
+
+	try
+	{
+		accel = embree::rtcCreateAccel(accelType, triangleLayout, embreeTri, count, embreeVert, vertexCount);
+	}
+	catch(...)
+	{
+		embree::scheduler = defaultScheduler;
+		throw;
+	}
+
+	embree::scheduler = defaultScheduler;
+
+	if(!cacheFile.empty() && !embree::rtcSaveAccel(accel, accelType, triangleLayout, key, cacheFile.c_str()))
+		std::cerr << std::endl << "[WARNING]: Could not write acceleration structure cache \"" << cacheFile << "\"." << std::endl;
+
+	return accel;
+}
+
+/*
+	Cache file of the "index"-th accel built for the scene, next to the input file. Accels are built in
+	a deterministic order, so the index identifies the same part of an unchanged scene on every run.
+*/
+static std::string GetCacheFile(RayTracer* tracer, size_t index)
+{
+	const RenderSettings& settings = tracer->GetSettings();
+
+	if(settings.noBvhCache || settings.inputFile.empty() || !settings.syntheticScene.empty())
+		return "";
+
+	return settings.inputFile + "." + std::to_string(index) + ".bvhcache";
+}
+
 RayIntersector::RayIntersector(RayTracer* tracer) : tracer(tracer)
 {
 	impl = std::make_shared<RayIntersector_Impl>();
 
 	auto triangles = tracer->GetTriangles();
-	int triCount = triangles.size();
-	embree::BuildTriangle* embreeTri = (embree::BuildTriangle*)embree::rtcMalloc(triCount * sizeof(embree::BuildTriangle));
-	embree::BuildVertex* embreeVert = (embree::BuildVertex*)embree::rtcMalloc(triCount * 3 * sizeof(embree::BuildVertex));
-	int i = 0, j = 0;
+	const int triCount = triangles.size();
+
+	/*
+		Triangles of a mesh are consecutive in the tracer's list. Prototypes placed more than once get
+		their own object space accel, everything else is merged into one world space accel.
+	*/
+	struct Placement { const Mesh* mesh; int firstTriangle; int triangleCount; };
+	std::vector<Placement> placements;
+	std::unordered_map<const Mesh*, int> placementsPerPrototype;
+
+	for(int i = 0; i < triCount; )
+	{
+		Placement placement = { triangles[i].GetMesh(), i, 0 };
+
+		while((i < triCount) && (triangles[i].GetMesh() == placement.mesh))
+		{
+			placement.triangleCount++;
+			i++;
+		}
+
+		if(placement.mesh->GetPrototype())
+			placementsPerPrototype[placement.mesh->GetPrototype()]++;
+
+		placements.push_back(placement);
+	}
+
+	auto isInstanced = [&](const Mesh* mesh) { return mesh->GetPrototype() && (placementsPerPrototype[mesh->GetPrototype()] > 1); };
+
+	if(std::none_of(placements.begin(), placements.end(), [&](const Placement& p) { return isInstanced(p.mesh); }))
+	{
+		impl->accels.push_back(BuildAccel(tracer, triCount, [&](int i) -> const Triangle& { return triangles[i]; }, nullptr, GetCacheFile(tracer, impl->accels.size()), impl->prepareSeconds, impl->cachedAccels));
+		impl->intersector = impl->accels.back()->queryInterface<embree::Intersector>();
 
-	for(auto& input : triangles)
+		return;
+	}
+
+	std::vector<InstanceIntersector::Instance> instances;
+	std::unordered_map<const Mesh*, std::pair<embree::Ref<embree::Intersector>, embree::BBox3f>> prototypeAccels;
+	std::vector<int> flatIds;
+
+	for(const auto& placement : placements)
 	{
-		auto a = input.GetPointA();
-		auto b = input.GetPointB();
-		auto c = input.GetPointC();
+		if(!isInstanced(placement.mesh))
+		{
+			for(int i = 0; i < placement.triangleCount; i++)
+			{
+				flatIds.push_back(placement.firstTriangle + i);
+			}
+
+			continue;
+		}
+
+		const Mesh* prototype = placement.mesh->GetPrototype();
+		auto& prototypeAccel = prototypeAccels[prototype];
+
+		if(!prototypeAccel.first)
+		{
+			auto protoTriangles = prototype->GetTriangles();
+
+			impl->accels.push_back(BuildAccel(tracer, (int)protoTriangles.size(), [&](int i) -> const Triangle& { return protoTriangles[i]; }, nullptr, GetCacheFile(tracer, impl->accels.size()), impl->prepareSeconds, impl->cachedAccels));
+			prototypeAccel.first = impl->accels.back()->queryInterface<embree::Intersector>();
+			prototypeAccel.second = embree::BBox3f(embree::empty);
 
-		embree::BuildTriangle& tri = embreeTri[i];
-		tri.id0 = i++;
-		tri.id1 = 0;
+			for(const auto& tri : protoTriangles)
+			{
+				prototypeAccel.second = embree::merge(prototypeAccel.second, tri.GetPointA());
+				prototypeAccel.second = embree::merge(prototypeAccel.second, tri.GetPointB());
+				prototypeAccel.second = embree::merge(prototypeAccel.second, tri.GetPointC());
+			}
+		}
 
-		tri.v0 = j;
-		embreeVert[j++] = embree::BuildVertex(a.x, a.y, a.z);
+		InstanceIntersector::Instance instance;
+		const embree::AffineSpace3f objectToWorld = ToAffineSpace(placement.mesh->GetTransform());
+		const embree::BBox3f& objectBounds = prototypeAccel.second;
 
-		tri.v1 = j;
-		embreeVert[j++] = embree::BuildVertex(b.x, b.y, b.z);
+		instance.intersector = prototypeAccel.first;
+		instance.worldToObject = embree::rcp(objectToWorld);
+		instance.bounds = embree::BBox3f(embree::empty);
+		instance.firstTriangle = placement.firstTriangle;
+		instance.triangleCount = placement.triangleCount;
+		instance.isIdentity = false;
 
-		tri.v2 = j;
-		embreeVert[j++] = embree::BuildVertex(c.x, c.y, c.z);
+		for(int corner = 0; corner < 8; corner++)
+		{
+			const Vector3 point(
+				(corner & 1) ? objectBounds.upper.x : objectBounds.lower.x,
+				(corner & 2) ? objectBounds.upper.y : objectBounds.lower.y,
+				(corner & 4) ? objectBounds.upper.z : objectBounds.lower.z);
+
+			instance.bounds = embree::merge(instance.bounds, embree::xfmPoint(objectToWorld, point));
+		}
+
+		instances.push_back(instance);
 	}
 
-	impl->accel = embree::rtcCreateAccel("default", "default", embreeTri, triCount, embreeVert, triCount * 3);
-	impl->intersector = impl->accel->queryInterface<embree::Intersector>();
+	if(!flatIds.empty())
+	{
+		// world space triangles keep their global index as id, so no offset is needed
+		InstanceIntersector::Instance instance;
+
+		impl->accels.push_back(BuildAccel(tracer, (int)flatIds.size(), [&](int i) -> const Triangle& { return triangles[flatIds[i]]; }, flatIds.data(), GetCacheFile(tracer, impl->accels.size()), impl->prepareSeconds, impl->cachedAccels));
+
+		instance.intersector = impl->accels.back()->queryInterface<embree::Intersector>();
+		instance.worldToObject = embree::AffineSpace3f(embree::one);
+		instance.bounds = embree::BBox3f(embree::empty);
+		instance.firstTriangle = 0;
+		instance.triangleCount = triCount;
+		instance.isIdentity = true;
+
+		for(int id : flatIds)
+		{
+			const Triangle& tri = triangles[id];
+
+			instance.bounds = embree::merge(instance.bounds, tri.GetPointA());
+			instance.bounds = embree::merge(instance.bounds, tri.GetPointB());
+			instance.bounds = embree::merge(instance.bounds, tri.GetPointC());
+		}
+
+		instances.push_back(instance);
+	}
+
+	impl->instances = new InstanceIntersector(std::move(instances));
+	impl->intersector = impl->instances.ptr;
 }
 
 bool RayIntersector::CastRay(ThreadContext& ctx, const PathSegment& incoming, PathSegment& outgoing)
@@ -67,17 +588,127 @@ bool RayIntersector::CastRay(ThreadContext& ctx, const PathSegment& incoming, Pa
 	embree::Hit hit;
 	Ray ray(outgoing.GetRay());
 
+	// the ray must not hit the triangle it starts on
 	if(incoming.GetTriangleAtImpact())
-		ctx.forbiddenTriangles.push_back(incoming.GetTriangleAtImpact()->GetFaceIndex());
+		ray.excludeId = incoming.GetTriangleAtImpact()->GetFaceIndex();
 
-	impl->intersector->intersect(ray, ctx.forbiddenTriangles, hit);
-	ctx.forbiddenTriangles.clear();
+	impl->intersector->intersect(ray, hit);
 	if(!hit)
 		return false;
 
-	outgoing.SetImpact(ray.org + hit.t * ray.dir);
+	outgoing.SetImpact(ray.org + hit.t * ray.dir, hit.u, hit.v);
 	outgoing.SetTriangleAtOrigin(incoming.GetTriangleAtImpact());
 	outgoing.SetTriangleAtImpact(&tracer->GetTriangles()[hit.id0]);
 
 	return true;
 }
+
+int RayIntersector::CastRays(ThreadContext& ctx, PathSegment* segments, int count)
+{
+	// the intersector splits into SIMD-wide packets itself, this only bounds the stack usage
+	const int chunkSize = 16;
+	Ray rays[chunkSize];
+	int hitCount = 0;
+
+	for(int offset = 0; offset < count; offset += chunkSize)
+	{
+		const int chunk = std::min(chunkSize, count - offset);
+
+		// the intersectors clip each ray to its incoming hit distance, so every chunk starts without hits
+		embree::Hit hits[chunkSize];
+
+		for(int i = 0; i < chunk; i++)
+		{
+			const Triangle* origin = segments[offset + i].GetTriangleAtOrigin();
+
+			rays[i] = segments[offset + i].GetRay();
+
+			// the ray must not hit the triangle it starts on
+			if(origin)
+				rays[i].excludeId = origin->GetFaceIndex();
+		}
+
+		impl->intersector->intersectPacket(rays, hits, chunk);
+
+		for(int i = 0; i < chunk; i++)
+		{
+			PathSegment& segment = segments[offset + i];
+
+			if(!hits[i])
+			{
+				segment.SetTriangleAtImpact(nullptr);
+				continue;
+			}
+
+			segment.SetImpact(rays[i].org + hits[i].t * rays[i].dir, hits[i].u, hits[i].v);
+			segment.SetTriangleAtImpact(&tracer->GetTriangles()[hits[i].id0]);
+			hitCount++;
+		}
+	}
+
+	return hitCount;
+}
+
+bool RayIntersector::IsOccluded(Vector3 origin, Vector3 direction, float near, float far, int excludeId)
+{
+	return impl->intersector->occluded(Ray(origin, direction, near, far, 0, excludeId));
+}
+
+double RayIntersector::GetPrepareSeconds() const
+{
+	return impl->prepareSeconds;
+}
+
+int RayIntersector::GetAccelCount() const
+{
+	return (int)impl->accels.size();
+}
+
+int RayIntersector::GetCachedAccelCount() const
+{
+	return impl->cachedAccels;
+}
+
+size_t RayIntersector::GetBytes() const
+{
+	size_t bytes = impl->instances ? impl->instances->GetBytes() : 0;
+
+	for(const auto& accel : impl->accels)
+		bytes += accel->bytes();
+
+	return bytes;
+}
+
+double RayIntersector::MeasureRaysPerSecond(int resolution) const
+{
+	Vector3 nearOrigin, nearXAxis, nearYAxis, farOrigin, farXAxis, farYAxis;
+	std::vector<Ray> rays;
+
+	tracer->GetCamera().GetRayRaster(nearOrigin, nearXAxis, nearYAxis, farOrigin, farXAxis, farYAxis);
+
+	for(int y = 0; y < resolution; y++)
+	{
+		for(int x = 0; x < resolution; x++)
+		{
+			float xn = (x + 0.5f) / resolution, yn = (y + 0.5f) / resolution;
+			Vector3 near = nearOrigin + nearXAxis * xn + nearYAxis * yn;
+			Vector3 far = farOrigin + farXAxis * xn + farYAxis * yn;
+
+			rays.push_back(Ray(near, Math::Normalized(far - near)));
+		}
+	}
+
+	StopWatch watch;
+
+	for(const auto& ray : rays)
+	{
+		// a shared hit would clip every ray to the previous impact and skip most of the traversal
+		embree::Hit hit;
+
+		impl->intersector->intersect(ray, hit);
+	}
+
+	double seconds = std::chrono::duration<double>(watch.GetElapsed()).count();
+
+	return rays.size() / std::max(seconds, 1e-9);
+}
@@ -20,12 +20,11 @@
 void RayTracer::SamplePhotonsFromScreen()
 {
 	ProgressBar<int> progress(GetWidth() * GetHeight());
-	const int MSAA_RESOLUTION = 16;
 	std::chrono::high_resolution_clock timer;
 
 	// allocate optional debug buffers
 	std::unique_ptr<RenderBuffer> debugLocal, debugEstimate, debugIndirect, debugDirect;
-	std::unique_ptr<UVMapNPOT<int64_t>> perfTotal;
+	std::unique_ptr<ChannelBuffer> perfTotal, perfDirect, perfIndirect, passesDirect, passesIndirect, raysCast, photonQueries;
 	{
 		const int w = GetWidth(), h = GetHeight();
 		if(GetSettings().pixelDebugMask & EPixelDebug::Local) debugLocal = std::make_unique<RenderBuffer>(w, h);
@@ -33,7 +32,17 @@ void RayTracer::SamplePhotonsFromScreen()
 		if(GetSettings().pixelDebugMask & EPixelDebug::Indirect) debugIndirect = std::make_unique<RenderBuffer>(w, h);
 		if(GetSettings().pixelDebugMask & EPixelDebug::Direct) debugDirect = std::make_unique<RenderBuffer>(w, h);
 
-		if(GetSettings().pixelPerfMonMask & EPixelPerfMon::Total) perfTotal = std::make_unique<UVMapNPOT<int64_t>>(w, h);
+		if(GetSettings().pixelPerfMonMask & EPixelPerfMon::Total) perfTotal = std::make_unique<ChannelBuffer>(w, h);
+		if(GetSettings().pixelPerfMonMask & EPixelPerfMon::Direct) perfDirect = std::make_unique<ChannelBuffer>(w, h);
+		if(GetSettings().pixelPerfMonMask & EPixelPerfMon::Indirect) perfIndirect = std::make_unique<ChannelBuffer>(w, h);
+
+		if(GetSettings().pixelPerfMonMask & EPixelPerfMon::Counts)
+		{
+			passesDirect = std::make_unique<ChannelBuffer>(w, h);
+			passesIndirect = std::make_unique<ChannelBuffer>(w, h);
+			raysCast = std::make_unique<ChannelBuffer>(w, h);
+			photonQueries = std::make_unique<ChannelBuffer>(w, h);
+		}
 	}
 
 	// actual rendering
@@ -44,12 +53,15 @@ void RayTracer::SamplePhotonsFromScreen()
 		{
 			WeightedPixel direct, indirect, mean;	
 			auto perfMark_Start = timer.now();
+			const ThreadStats statsAtStart = ctx.stats;
 			const int x = ssp.xScreen, y = ssp.yScreen;
-			int passes = 0;
+			int passes = 0, directPasses;
 			Pixel lastMean;
 			float delta;
 			Pixel directPixel, indirectPixel;
 
+			ctx.sampler->StartPixel(y * GetWidth() + x);
+
 			do
 			{
 				passes++;
@@ -57,19 +69,32 @@ void RayTracer::SamplePhotonsFromScreen()
 
 				ctx.msaaSamples.clear();
 
+				// every pass of every pixel has its own random sequence, independent of thread scheduling
+				ctx.random.Seed(ERandomStream::ScreenDirect, y * GetWidth() + x, passes);
+
+				ctx.primaryRays.clear();
+
 				for(int i = 0; i < settings.msaaSamples; i++)
 				{
-					// collect MSAA coordinates
-					float xMsaa = ssp.xDelta / MSAA_RESOLUTION;
-					float yMsaa = ssp.yDelta / MSAA_RESOLUTION;
+					// collect MSAA coordinates, stratified over all passes of this pixel
+					float msaa[2];
+					ctx.sampler->Get2D(ESampleDimension::MsaaDirect, msaa);
 					PathSegment screenSegment;
-					Ray ray(ssp.GetRay(ssp.xNdc + xMsaa * (std::rand() % MSAA_RESOLUTION), ssp.yNdc + yMsaa * (std::rand() % MSAA_RESOLUTION)));
+					Ray ray(ssp.GetRay(ssp.xNdc + ssp.xDelta * msaa[0], ssp.yNdc + ssp.yDelta * msaa[1]));
 
 					screenSegment.SetDirection(ray.dir);
 					screenSegment.SetOrigin(ray.org);
 					screenSegment.SetTriangleAtImpact(nullptr);
 
-					if(!ctx.CastRay(screenSegment, screenSegment))
+					ctx.primaryRays.push_back(screenSegment);
+				}
+
+				// all MSAA rays of a pass share the pixel footprint, so trace them as one coherent packet
+				ctx.CastRays(ctx.primaryRays.data(), (int)ctx.primaryRays.size(), ERayKind::Primary);
+
+				for(const auto& screenSegment : ctx.primaryRays)
+				{
+					if(!screenSegment.HasImpact())
 					{
 						direct += WeightedPixel(1, GetClearColor());
 						indirect += WeightedPixel(1, GetClearColor());
@@ -91,7 +116,10 @@ void RayTracer::SamplePhotonsFromScreen()
 			}while(((passes < 2) || (delta > 0.001 * Math::MaxElem((Pixel)mean))) && (passes < 100));
 
 			frameBuffer(x, y) = directPixel = (Pixel)mean;
+			ctx.stats.directPasses += passes;
+			directPasses = passes;
 
+			auto perfMark_Direct = timer.now();
 			passes = 0;
 			mean = WeightedPixel();
 
@@ -102,19 +130,32 @@ void RayTracer::SamplePhotonsFromScreen()
 
 				ctx.msaaSamples.clear();
 
+				// every pass of every pixel has its own random sequence, independent of thread scheduling
+				ctx.random.Seed(ERandomStream::ScreenIndirect, y * GetWidth() + x, passes);
+
+				ctx.primaryRays.clear();
+
 				for(int i = 0; i < settings.msaaSamples; i++)
 				{
-					// collect MSAA coordinates
-					float xMsaa = ssp.xDelta / MSAA_RESOLUTION;
-					float yMsaa = ssp.yDelta / MSAA_RESOLUTION;
+					// collect MSAA coordinates, stratified over all passes of this pixel
+					float msaa[2];
+					ctx.sampler->Get2D(ESampleDimension::MsaaIndirect, msaa);
 					PathSegment screenSegment;
-					Ray ray(ssp.GetRay(ssp.xNdc + xMsaa * (std::rand() % MSAA_RESOLUTION), ssp.yNdc + yMsaa * (std::rand() % MSAA_RESOLUTION)));
+					Ray ray(ssp.GetRay(ssp.xNdc + ssp.xDelta * msaa[0], ssp.yNdc + ssp.yDelta * msaa[1]));
 
 					screenSegment.SetDirection(ray.dir);
 					screenSegment.SetOrigin(ray.org);
 					screenSegment.SetTriangleAtImpact(nullptr);
 
-					if(!ctx.CastRay(screenSegment, screenSegment))
+					ctx.primaryRays.push_back(screenSegment);
+				}
+
+				// all MSAA rays of a pass share the pixel footprint, so trace them as one coherent packet
+				ctx.CastRays(ctx.primaryRays.data(), (int)ctx.primaryRays.size(), ERayKind::Primary);
+
+				for(const auto& screenSegment : ctx.primaryRays)
+				{
+					if(!screenSegment.HasImpact())
 					{
 						direct += WeightedPixel(1, GetClearColor());
 						indirect += WeightedPixel(1, GetClearColor());
@@ -143,12 +184,22 @@ void RayTracer::SamplePhotonsFromScreen()
 			}while(((passes < 2) || (delta > 0.001 * Math::MaxElem((Pixel)mean))) && (passes < 100));
 
 			frameBuffer(x, y) += indirectPixel = (Pixel)mean;
+			ctx.stats.indirectPasses += passes;
+			ctx.stats.pixels++;
 
 			auto perfMark_End = timer.now();
 
 
 			// store performance data
-			if(perfTotal) (*perfTotal)(x, y) = std::chrono::duration_cast<std::chrono::nanoseconds>(perfMark_End - perfMark_Start).count();
+			auto nanoseconds = [](decltype(perfMark_End - perfMark_Start) duration) { return (float)std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(); };
+
+			if(perfTotal) (*perfTotal)(x, y) = nanoseconds(perfMark_End - perfMark_Start);
+			if(perfDirect) (*perfDirect)(x, y) = nanoseconds(perfMark_Direct - perfMark_Start);
+			if(perfIndirect) (*perfIndirect)(x, y) = nanoseconds(perfMark_End - perfMark_Direct);
+			if(passesDirect) (*passesDirect)(x, y) = (float)directPasses;
+			if(passesIndirect) (*passesIndirect)(x, y) = (float)passes;
+			if(raysCast) (*raysCast)(x, y) = (float)(ctx.stats.GetRaysCast() - statsAtStart.GetRaysCast());
+			if(photonQueries) (*photonQueries)(x, y) = (float)(ctx.stats.photonQueries - statsAtStart.photonQueries);
 
 			// store debug data
 			if(debugLocal) (*debugLocal)(x, y) = ctx.msaaSamples.front().GetMaterialAtImpact()->ComputeLocalIllumination(ctx, ctx.msaaSamples.front());
@@ -159,7 +210,22 @@ void RayTracer::SamplePhotonsFromScreen()
 			progress += 1;
 		});
 
-	if(perfTotal) WritePerformanceData(*perfTotal.get(), ".perf_total.exr"); 
+	CloseStage("SamplePhotonsFromScreen");
+
+	// all performance data goes into one multi-layer file
+	{
+		std::vector<std::pair<std::string, const ChannelBuffer*>> channels;
+
+		if(perfTotal) channels.push_back(std::make_pair("time.total", perfTotal.get()));
+		if(perfDirect) channels.push_back(std::make_pair("time.direct", perfDirect.get()));
+		if(perfIndirect) channels.push_back(std::make_pair("time.indirect", perfIndirect.get()));
+		if(passesDirect) channels.push_back(std::make_pair("passes.direct", passesDirect.get()));
+		if(passesIndirect) channels.push_back(std::make_pair("passes.indirect", passesIndirect.get()));
+		if(raysCast) channels.push_back(std::make_pair("work.rays", raysCast.get()));
+		if(photonQueries) channels.push_back(std::make_pair("work.knn", photonQueries.get()));
+
+		ChannelBuffer::SaveToEXR(GetSettings().outputFile + ".perf.exr", channels);
+	}
 
 	if(debugLocal) debugLocal->SaveToEXR(GetSettings().outputFile + ".debug_local.exr");
 	if(debugEstimate) debugEstimate->SaveToEXR(GetSettings().outputFile + ".debug_estimate.exr");
@@ -167,31 +233,6 @@ void RayTracer::SamplePhotonsFromScreen()
 	if(debugDirect) debugDirect->SaveToEXR(GetSettings().outputFile + ".debug_direct.exr");
 }
 
-void RayTracer::WritePerformanceData(const UVMapNPOT<int64_t>& data, std::string extension)
-{
-	const int w = data.GetWidth(), h = data.GetHeight();
-	RenderBuffer rgb(w, h);
-
-	// find min/max
-	int64_t min = data(0,0), max = min;
-	TraverseImage(Rect(0, 0, w, h), [&](int x, int y)
-	{
-		auto d = data(x, y);
-		min = std::min(min, d);
-		max = std::max(max, d);
-	});
-
-	// normalize to RGB
-	TraverseImage(Rect(0, 0, w, h), [&](int x, int y)
-	{
-		auto d = data(x, y);
-		auto norm = (d - min) / (float)(max - min);
-		rgb(x, y) = Pixel(norm, 1 - norm, 0, d);
-	});
-
-	rgb.SaveToEXR(GetSettings().outputFile + extension);
-}
-
 void RayTracer::TracePhoton(ThreadContext& ctx, const PathSegment& emitted)
 {
 	ctx.transmissionsSwap.clear();
@@ -222,7 +263,7 @@ void RayTracer::TracePhoton(ThreadContext& ctx, const PathSegment& emitted)
 
 void RayTracer::SaveTransmission(ThreadContext& ctx, const PathSegment& current, PathSegment& outgoing)
 {
-	if(outgoing.IsAlive() && ctx.CastRay(current, outgoing))
+	if(outgoing.IsAlive() && ctx.CastRay(current, outgoing, ERayKind::Photon))
 	{
 		PathSegment* allocated;
 		
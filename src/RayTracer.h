@@ -21,11 +21,14 @@
 
 #include "RayTracerFwd.h"
 #include "Pixel.h"
+#include "Random.h"
 #include "Math.h"
+#include "Sampler.h"
 #include "BinaryReader.h"
 #include "BinaryWriter.h"
 #include "UnifiedSettings.h"
 #include "ProgressBar.h"
+#include "TaskPool.h"
 #include "UVMap.h"
 #include "TextureMap.h"
 #include "RenderSettings.h"
@@ -40,9 +43,11 @@
 #include "Camera.h"
 #include "Scene.h"
 #include "UnityImporter.h"
+#include "SyntheticScene.h"
 #include "PhotonMap.h"
 #include "ThreadContext.h"
 #include "RaytracerImpl.h"
+#include "StageBenchmark.h"
 #include "OpenGLWindow.h"
 #include "RenderPreviewWindow.h"
 
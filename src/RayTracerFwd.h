@@ -31,8 +31,10 @@ class Scene;
 struct Pixel;
 class TextureMap;
 class UnityImporter;
+class SyntheticScene;
 class RayTracer;
 class ThreadContext;
+class Sampler;
 template<class TUVEntry> class UVMap;
 class PathSegment;
 class RenderSettings;
@@ -80,6 +82,7 @@ struct MultiplicativeBSDFEntry;
 	#include <cstring>
 	#include <ctime>
 	#include <cmath>
+	#include <xmmintrin.h>
 
 	#define BOOST_ALL_NO_LIB
 
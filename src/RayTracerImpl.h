@@ -28,6 +28,28 @@ private:
 public:
 	RayIntersector(RayTracer* tracer);
 	bool CastRay(ThreadContext& ctx, const PathSegment& incoming, PathSegment& outgoing);
+
+	/*
+		Traces "count" segments as ray packets, each ignoring the triangle at its origin (if any).
+		Segments that hit something get their impact set, returns the number of hits.
+	*/
+	int CastRays(ThreadContext& ctx, PathSegment* segments, int count);
+
+	/** Any-hit query, true if something other than triangle "excludeId" lies on the ray within [near, far] (in units of "direction"). */
+	bool IsOccluded(Vector3 origin, Vector3 direction, float near, float far, int excludeId = -1);
+
+	/** Time spent copying triangles into embree's build buffers and looking them up in the cache, the rest of the build is embree's own. */
+	double GetPrepareSeconds() const;
+
+	/** Number of embree accels making up the structure and how many of them were loaded from the cache. */
+	int GetAccelCount() const;
+	int GetCachedAccelCount() const;
+
+	/** Memory used by the acceleration structure in bytes. */
+	size_t GetBytes() const;
+
+	/** Casts resolution^2 camera rays on the calling thread and returns the achieved rays per second. */
+	double MeasureRaysPerSecond(int resolution) const;
 };
 
 struct ScreenSpacePosition
@@ -42,6 +64,12 @@ struct ScreenSpacePosition
 	std::function<Ray (float, float)> GetRay;
 };
 
+struct StageStats
+{
+	std::string name;
+	ThreadStats stats;
+};
+
 class RayTracer : boost::noncopyable
 {
 private:
@@ -62,9 +90,21 @@ private:
 	std::vector<Triangle> triangles;
 	std::vector<BSDFMaterial*> triToMatMap;
 	std::vector<ThreadContext> threadCtx;
-
-	void RunParallel(std::function<void (ThreadContext& ctx)> task);
-	void SamplePhotonsFromScreen();
+	std::unique_ptr<TaskPool> taskPool;
+	double bvhBuildSeconds;
+	double bvhPrepareSeconds;
+	int bvhAccels;
+	int bvhCachedAccels;
+	size_t bvhBytes;
+	double bvhRaysPerSecond;
+	std::vector<StageStats> stageStats;
+	bool hasCausticMaterials;
+
+	/*
+		Runs "task" on the task pool for disjoint subranges of [0, count), each with at most
+		"grainSize" elements, and waits for completion. "ctx" belongs to the executing worker.
+	*/
+	void ParallelFor(int count, int grainSize, std::function<void (ThreadContext& ctx, int begin, int end)> task);
 	void TracePhoton(ThreadContext& ctx, const PathSegment& emitted);
 	static std::pair<int, int> GetDimensionsFromLongestEdge(const Camera& camera, int longestEdge);
 	void SaveTransmission(ThreadContext& ctx, const PathSegment& current, PathSegment& outgoing);
@@ -72,7 +112,9 @@ private:
 	Pixel ComputeIndirectIllumination_MSAA(ThreadContext& ctx, const std::vector<PathSegment>& msaaView) const;
 	WeightedPixel ComputeDirectIllumination_MSAA(ThreadContext& ctx, const std::vector<PathSegment>& msaaView) const;
 	void ComputeDirectIllumination_Cluster(ThreadContext& ctx, const MSAACluster& cluster) const;
-	void WritePerformanceData(const UVMapNPOT<int64_t>& data, std::string extension);
+
+	/** Merges and resets the counters of all thread contexts into a new entry of "stageStats". */
+	void CloseStage(std::string name);
 public:
 
 	const RenderSettings& GetSettings() const { return settings; }
@@ -90,8 +132,39 @@ public:
 
 	void TracePhotons();
 
+	/** Builds the kd-trees of all three photon maps, needs to be called after TracePhotons(). */
+	void BuildPhotonMaps();
+
+	/** Renders into the frame buffer, needs to be called after BuildPhotonMaps(). */
+	void SamplePhotonsFromScreen();
+
+	/** Builds the photon maps, renders the image and saves it to the output file. */
 	void RenderImage();
 
+	/** Wall time the constructor spent building the ray intersection structure. */
+	double GetBVHBuildSeconds() const { return bvhBuildSeconds; }
+
+	/** Part of the build time spent preparing the triangles for the builder. */
+	double GetBVHPrepareSeconds() const { return bvhPrepareSeconds; }
+
+	/** Number of embree accels built for the scene and how many of them came from the cache instead. */
+	int GetBVHAccelCount() const { return bvhAccels; }
+	int GetBVHCachedAccelCount() const { return bvhCachedAccels; }
+
+	/** Memory footprint of the ray intersection structure. */
+	size_t GetBVHBytes() const { return bvhBytes; }
+
+	/** Single threaded primary ray throughput, measured by the constructor. */
+	double GetBVHRaysPerSecond() const { return bvhRaysPerSecond; }
+
+	/** Counters of all stages completed so far, in order of execution. */
+	const std::vector<StageStats>& GetStageStats() const { return stageStats; }
+
+	void WriteStatsJSON(std::ostream& out) const;
+
+	/** True if any material can transmit camera paths, otherwise visibility reduces to occlusion queries. */
+	bool HasCausticMaterials() const { return hasCausticMaterials; }
+
 	int GetWidth() const { return width; }
 	int GetHeight() const { return height; }
 
@@ -99,6 +172,9 @@ public:
 
 	int GetThreadCount() const { return (int)threadCtx.size(); }
 
+	TaskPool& GetTaskPool() { return *taskPool; }
+	ThreadContext& GetThreadContext(int threadIndex) { return threadCtx[threadIndex]; }
+
 	Pixel GetClearColor() const { return Pixel(0.5,0.5,0.5); }
 
 	RenderBuffer& GetFrameBuffer() { return frameBuffer; }
@@ -108,6 +184,12 @@ public:
 	PhotonMap& GetCausticsMap() { return causticsMap; }
 
 	Pixel EstimateIndirectIllumination(ThreadContext& ctx, const PathSegment& view) const;
+
+	/**
+		Estimates the light arriving along "count" traced rays at once, their photon searches being one batch.
+		Rays that left the scene see the clear color.
+	*/
+	void EstimateIndirectIllumination(ThreadContext& ctx, const PathSegment* views, int count, Pixel* outEstimates) const;
 };
 
 #endif
\ No newline at end of file
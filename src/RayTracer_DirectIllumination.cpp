@@ -44,13 +44,30 @@ void RayTracer::ComputeDirectIllumination_Cluster(ThreadContext& ctx, const MSAA
 		// traverse on a straight line towards light source, skipping transparent BSDFs
 		BSDFMaterial* lightMaterial = emitted->GetMaterialAtOrigin();
 		PathSegment shadowSegment;
+		ETransmissionResult transmission;
+		bool reachedLight;
+		const Triangle* lightTriangle;
 
 		shadowSegment.SetOrigin(view.GetImpact());
 		shadowSegment.SetDirection(dir);
 		shadowSegment.SetTriangleAtOrigin(view.GetTriangleAtImpact());
 
-		// TODO: "false" workaround as long as there are no caustics, otherwise our CourtYard pool will be black :(
-		switch(ctx.FollowTransmissiveEx(shadowSegment, nullptr, false/*light->IsDirectional()*/))
+		if(!light->IsDirectional() && !HasCausticMaterials())
+		{
+			// nothing to walk through, so the light is reached exactly if the segment towards it is unblocked
+			transmission = ETransmissionResult::Success;
+			reachedLight = ctx.IsSegmentVisible(view.GetImpact(), view.GetTriangleAtImpact(), emitted->GetOrigin(), ERayKind::Shadow);
+			lightTriangle = reachedLight ? emitted->GetTriangleAtOrigin() : nullptr;
+		}
+		else
+		{
+			// TODO: "false" workaround as long as there are no caustics, otherwise our CourtYard pool will be black :(
+			transmission = ctx.FollowTransmissiveEx(shadowSegment, nullptr, false/*light->IsDirectional()*/, ERayKind::Shadow);
+			reachedLight = (transmission == ETransmissionResult::Success) && (shadowSegment.GetMaterialAtImpact() == lightMaterial);
+			lightTriangle = shadowSegment.GetTriangleAtImpact();
+		}
+
+		switch(transmission)
 		{
 		case ETransmissionResult::EmptySpace:
 			bsdfEntry->color = ctx.GetTracer()->GetClearColor();
@@ -63,16 +80,14 @@ void RayTracer::ComputeDirectIllumination_Cluster(ThreadContext& ctx, const MSAA
 		
 		case ETransmissionResult::Success:
 			// path leads to non-transmissive material
-			BSDFMaterial* impactMat = shadowSegment.GetMaterialAtImpact();
 			PathSegment lightSegment;
 
 			lightSegment.SetDirection(-dir);
 			lightSegment.SetOrigin(view.GetImpact() + dir);
-			lightSegment.SetImpact(view.GetImpact());
-			lightSegment.SetTriangleAtImpact(view.GetTriangleAtImpact());
-			lightSegment.SetTriangleAtOrigin(shadowSegment.GetTriangleAtImpact());
+			lightSegment.CopyImpact(view);
+			lightSegment.SetTriangleAtOrigin(lightTriangle);
 
-			if(impactMat != lightMaterial)
+			if(!reachedLight)
 			{
 				// this path does not lead to a light-source!
 				lightSegment.SetColor(Pixel());
@@ -84,9 +99,10 @@ void RayTracer::ComputeDirectIllumination_Cluster(ThreadContext& ctx, const MSAA
 			}
 
 			bsdfEntry->color = bsdfEntry->bsdf->ComputeDirectIllumination(ctx, view, lightSegment);
+			ctx.stats.bsdfEvaluations[EBsdfEvaluation::DirectIllumination]++;
 
 			if(!bsdfEntry->material->HasCausticBsdfs())
-				bsdfEntry->color *= bsdfEntry->material->ShadeSurface(view);
+				bsdfEntry->color *= bsdfEntry->material->ShadeSurface(ctx, view);
 
 			break;
 		}
@@ -136,7 +152,7 @@ WeightedPixel RayTracer::ComputeDirectIllumination_MSAA(ThreadContext& ctx, cons
 					continue;
 
 				// create new cluster (expensive)
-				ctx.GetDirectMap().Sample(bsdfEntry->view.GetImpact(), 256, ctx.samples);
+				ctx.SamplePhotons(ctx.GetDirectMap(), bsdfEntry->view.GetImpact(), 256);
 
 				if(ctx.msaaClusters.size() <= iCluster)
 					ctx.msaaClusters.push_back(MSAACluster());
@@ -146,7 +162,7 @@ WeightedPixel RayTracer::ComputeDirectIllumination_MSAA(ThreadContext& ctx, cons
 			}
 			else if(bsdfEntry->bsdf->IsCausticBsdf())
 			{
-				bsdfEntry->color = bsdfEntry->material->ShadeSurface(bsdfEntry->view);
+				bsdfEntry->color = bsdfEntry->material->ShadeSurface(ctx, bsdfEntry->view);
 			}
 		}
 	}
@@ -49,7 +49,8 @@ RayTracer::RayTracer(std::shared_ptr<Scene> scene, RenderSettings settings)
 	indirectMap(*this, settings.photonCount),
 	causticsMap(*this, indirectMap.GetTotalPhotonCount()),
 	frameBuffer(width, height),
-	directMap(*this, indirectMap.GetTotalPhotonCount())
+	directMap(*this, indirectMap.GetTotalPhotonCount()),
+	hasCausticMaterials(false)
 {
 	if(std::distance(scene->GetLights().begin(), scene->GetLights().end()) == 0)
 		std::invalid_argument("A scene needs at least one light source!");
@@ -60,6 +61,7 @@ RayTracer::RayTracer(std::shared_ptr<Scene> scene, RenderSettings settings)
 		BSDFMaterial* mat = mesh->GetMaterial();
 
 		mat->ApplyDefaultSettings(settings);
+		hasCausticMaterials |= mat->HasCausticBsdfs();
 
 		for(auto& tri : mesh->GetTriangles())
 		{
@@ -69,38 +71,82 @@ RayTracer::RayTracer(std::shared_ptr<Scene> scene, RenderSettings settings)
 		}
 	}
 
-	// create thread-contexts for further computational stages
-	for(int iThread = 0; iThread < settings.threadCount; iThread++)
+	const EPhotonLookup lookup = (settings.photonLookup == "grid") ? EPhotonLookup::Grid : EPhotonLookup::KDTree;
+
+	indirectMap.SetLookup(lookup);
+	causticsMap.SetLookup(lookup);
+	directMap.SetLookup(lookup);
+
+	// one persistent worker pool for all stages, each worker owns the thread-context with its index
+	taskPool = std::make_unique<TaskPool>(settings.threadCount);
+
+	for(int iThread = 0; iThread < taskPool->GetThreadCount(); iThread++)
 	{
 		threadCtx.emplace_back(ThreadContext(this, iThread));
 	}
 
 	// creates spatial data structure for the triangles above, with full parallelization.
+	StopWatch watch;
 	auto intersector = std::make_shared<RayIntersector>(this);
 	for(auto& ctx : threadCtx)ctx.SetIntersector(intersector);
+	bvhBuildSeconds = std::chrono::duration<double>(watch.GetElapsed()).count();
+	bvhPrepareSeconds = intersector->GetPrepareSeconds();
+	bvhAccels = intersector->GetAccelCount();
+	bvhCachedAccels = intersector->GetCachedAccelCount();
+	bvhBytes = intersector->GetBytes();
+	bvhRaysPerSecond = intersector->MeasureRaysPerSecond(256);
 }
 
+void RayTracer::CloseStage(std::string name)
+{
+	StageStats stage;
 
-void RayTracer::RunParallel(std::function<void (ThreadContext& ctx)> task)
+	stage.name = name;
+
+	for(auto& ctx : threadCtx)
+	{
+		stage.stats += ctx.stats;
+		ctx.stats.Reset();
+	}
+
+	stageStats.push_back(stage);
+}
+
+void RayTracer::WriteStatsJSON(std::ostream& out) const
 {
-	auto threads = std::vector<std::thread>();
+	out << "{" << std::endl;
+	out << "  \"threads\": " << GetThreadCount() << "," << std::endl;
+	out << "  \"accel\": { \"type\": \"" << settings.accel << "\", \"triangles\": \"" << settings.triangleLayout << "\", "
+		<< "\"build_seconds\": " << bvhBuildSeconds << ", \"prepare_seconds\": " << bvhPrepareSeconds << ", \"accels\": " << bvhAccels << ", \"cached_accels\": " << bvhCachedAccels << ", \"bytes\": " << bvhBytes << ", \"rays_per_second\": " << bvhRaysPerSecond << " }," << std::endl;
+	out << "  \"photon_lookup\": \"" << settings.photonLookup << "\"," << std::endl;
+	out << "  \"stages\": [" << std::endl;
+
+	for(size_t i = 0; i < stageStats.size(); i++)
+	{
+		out << "    { \"name\": \"" << stageStats[i].name << "\", \"stats\": ";
+		stageStats[i].stats.WriteJSON(out, "      ");
+		out << " }" << ((i + 1 < stageStats.size()) ? "," : "") << std::endl;
+	}
+
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
+
 
+void RayTracer::ParallelFor(int count, int grainSize, std::function<void (ThreadContext& ctx, int begin, int end)> task)
+{
 	if(GetThreadCount() == 1)
 	{
 		// better stack traces if not artificially "parallelized"...
-		task(threadCtx[0]);
+		if(count > 0)
+			task(threadCtx[0], 0, count);
 	}
 	else
 	{
-		for(auto& ctx : threadCtx)
+		taskPool->ParallelFor(0, count, grainSize, [&](int workerIndex, int begin, int end)
 		{
-			threads.emplace_back(std::thread([&]()
-			{
-				task(ctx);
-			}));
-		}
-
-		for(auto& t : threads) t.join();
+			task(threadCtx[workerIndex], begin, end);
+		});
 	}
 }
 
@@ -132,10 +178,10 @@ void RayTracer::TraverseScreenSpace(
 		return Ray(near, Math::Normalized(far - near));
 	};
 
-	// subdivide image screen into small processing blocks
-	int minBlocks = 4 * (int)std::ceil(std::sqrtf(GetThreadCount()));
-	int xStep = std::max(minBlocks, xResolution / 32);
-	int yStep = std::max(minBlocks, yResolution / 32);
+	// subdivide image screen into small tiles, the task pool balances their very uneven costs
+	const int TILE_SIZE = 8;
+	int xStep = TILE_SIZE;
+	int yStep = TILE_SIZE;
 	for(int x = 0; x < xResolution; x += xStep)
 	{
 		int bWidth = std::min(xStep, xResolution - x); 
@@ -148,12 +194,9 @@ void RayTracer::TraverseScreenSpace(
 	}
 
 	// process all processing blocks
-	std::atomic<int> blockIndex(0);
-
-	RunParallel([&](ThreadContext& ctx)
+	ParallelFor((int)blocks.size(), 1, [&](ThreadContext& ctx, int begin, int end)
 	{
-		int localIndex;
-		while((localIndex = blockIndex++) < blocks.size())
+		for(int localIndex = begin; localIndex < end; localIndex++)
 		{
 			Rect block = blocks[localIndex];
 
@@ -176,42 +219,130 @@ void RayTracer::TraverseScreenSpace(
 	});
 }
 
+/*
+	Splits "total" photons between the lights proportional to their power, the rounding remainder
+	going to the largest fractions. Every light with power keeps at least one photon, so none of
+	them drops out of the image, all lights share equally if none has any power.
+*/
+static std::vector<int> ComputePhotonBudgets(const std::vector<LightSource*>& lights, int total)
+{
+	std::vector<int> budgets(lights.size());
+	std::vector<std::pair<double, int>> fractions;
+	double totalPower = 0;
+	int assigned = 0;
+
+	for(const auto light : lights)
+		totalPower += std::max(0.0, light->GetPower());
+
+	for(size_t i = 0; i < lights.size(); i++)
+	{
+		const double power = std::max(0.0, lights[i]->GetPower());
+		const double share = (totalPower > 0) ? total * power / totalPower : total / (double)lights.size();
+
+		budgets[i] = (int)share;
+
+		if((budgets[i] == 0) && ((power > 0) || (totalPower <= 0)))
+			budgets[i] = 1;
+		else
+			fractions.push_back(std::make_pair(share - budgets[i], (int)i));
+
+		assigned += budgets[i];
+	}
+
+	std::stable_sort(fractions.begin(), fractions.end(), [](const std::pair<double, int>& a, const std::pair<double, int>& b) { return a.first > b.first; });
+
+	for(size_t i = 0; (i < fractions.size()) && (fractions[i].first > 0) && (assigned < total); i++, assigned++)
+	{
+		budgets[fractions[i].second]++;
+	}
+
+	return budgets;
+}
+
 void RayTracer::TracePhotons()
 {
-	std::vector<int> photonCounts;
+	/*
+		Every batch emits PHOTONS_PER_LIGHT photons per light on average, split between the lights
+		proportional to their power. Photons of lights with a smaller share than the average carry
+		more energy, so the expected image stays the same and only the photon memory moves to the
+		lights that contribute the most.
+	*/
+	const int PHOTONS_PER_LIGHT = 100;
+	std::vector<LightSource*> lights(scene->GetLights().begin(), scene->GetLights().end());
+	std::vector<int> photonCounts(lights.size());
+	std::vector<LightSource*> emitting;
 
-	for(const auto& light : scene->GetLights())
 	{
-		photonCounts.push_back(100);
+		const std::vector<int> budgets = ComputePhotonBudgets(lights, PHOTONS_PER_LIGHT * (int)lights.size());
+
+		for(size_t i = 0; i < lights.size(); i++)
+		{
+			photonCounts[lights[i]->GetIndex()] = budgets[i];
+			lights[i]->SetPhotonScale((budgets[i] > 0) ? PHOTONS_PER_LIGHT / (float)budgets[i] : 0);
+
+			if(budgets[i] > 0)
+				emitting.push_back(lights[i]);
+		}
 	}
 
 	ProgressBar<int> progress(indirectMap.GetTotalPhotonCount());
 
-	RunParallel([&](ThreadContext& ctx)
+	/*
+		The number of batches needed to fill the map is not known in advance, because photons
+		may get absorbed. So batches are submitted in rounds of fixed size until the map is full.
+		The round size does not depend on the thread count, to keep batch indices reproducible.
+		Threads reserve one chunk at a time, a chunk being the photons of one light in one batch,
+		so lights without a budget cost nothing and bright lights spread over all threads.
+	*/
+	const int BATCHES_PER_ROUND = 256;
+	const int chunksPerRound = BATCHES_PER_ROUND * (int)emitting.size();
+
+	for(int round = 0; (chunksPerRound > 0) && (indirectMap.GetRegisteredPhotonCount() < indirectMap.GetTotalPhotonCount()); round++)
 	{
-		while(indirectMap.GetRegisteredPhotonCount() < indirectMap.GetTotalPhotonCount())
+		ParallelFor(chunksPerRound, 1, [&](ThreadContext& ctx, int begin, int end)
 		{
-			for(const auto light : scene->GetLights())
+			for(int chunk = begin; chunk < end; chunk++)
 			{
-				int iLight = light->GetIndex();
+				if(indirectMap.GetRegisteredPhotonCount() >= indirectMap.GetTotalPhotonCount())
+					return;
+
+				const int batch = chunk / (int)emitting.size();
+				const LightSource* light = emitting[chunk % emitting.size()];
+				const int iLight = light->GetIndex();
+
+				// each photon batch gets its own random sequence
+				ctx.random.Seed(ERandomStream::Photon, iLight, round * BATCHES_PER_ROUND + batch);
 
 				for(int i = 0; i < photonCounts[iLight]; i++)
 				{
-					light->EmitPhoton(ctx);
+					light->EmitPhoton(ctx, i, photonCounts[iLight]);
 				}
 
 				progress = indirectMap.GetRegisteredPhotonCount();
 			}
-		}
+		});
+	}
+
+	CloseStage("TracePhotons");
+}
+
+void RayTracer::BuildPhotonMaps()
+{
+	// the three maps are independent, so build them concurrently, each of them splitting into further tasks
+	PhotonMap* maps[] = { &indirectMap, &directMap, &causticsMap };
+
+	taskPool->ParallelFor(0, 3, 1, [&](int workerIndex, int begin, int end)
+	{
+		for(int i = begin; i < end; i++)
+			maps[i]->Build(*taskPool, workerIndex);
 	});
+
+	CloseStage("BuildPhotonMaps");
 }
 
 void RayTracer::RenderImage()
 {
-	indirectMap.Build();
-	directMap.Build();
-	causticsMap.Build();
-
+	BuildPhotonMaps();
 	SamplePhotonsFromScreen();
 
 	frameBuffer.SaveToEXR(settings.outputFile);
@@ -20,14 +20,39 @@
 
 Pixel RayTracer::ComputeIndirectIllumination_MSAA(ThreadContext& ctx, const std::vector<PathSegment>& msaaView) const
 {
-	WeightedPixel pixel;
+	/*
+		The camera paths of all MSAA samples are tracked first, collecting the hemisphere rays of all
+		their lighting BSDFs. These are traced as one coherence sorted stream before any path is shaded.
+	*/
+	ctx.ResetBSDFGroups();
+	ctx.indirectRays.clear();
+
 	for(PathSegment view : msaaView)
 	{
 		view.ResetImpact();
 
-		ctx.ResetBSDFGroups();
 		auto bsdfGroup = ctx.AllocateBsdfGroup();
 		BSDFMaterial::TrackCameraPath(ctx, view, bsdfGroup.get());
+
+		for(const auto& bsdfEntry : *bsdfGroup)
+		{
+			if(bsdfEntry->bsdf && bsdfEntry->bsdf->IsLightingBsdf())
+				bsdfEntry->bsdf->SampleIndirectIllumination(ctx, bsdfEntry->view, ctx.indirectRays);
+		}
+	}
+
+	ctx.CastRayStream(ctx.indirectRays.data(), (int)ctx.indirectRays.size(), ERayKind::Indirect);
+
+	// the photon searches at all impacts are issued as one batch
+	ctx.indirectEstimates.resize(ctx.indirectRays.size());
+	EstimateIndirectIllumination(ctx, ctx.indirectRays.data(), (int)ctx.indirectRays.size(), ctx.indirectEstimates.data());
+
+	// shade in the same order the rays were sampled, every lighting BSDF consumes its "subSamples" rays
+	WeightedPixel pixel;
+	int nextRay = 0;
+
+	for(const auto& bsdfGroup : ctx.bsdfGroups)
+	{
 		Pixel color(1,1,1);
 
 		for(const auto& bsdfEntry : *bsdfGroup)
@@ -40,17 +65,18 @@ Pixel RayTracer::ComputeIndirectIllumination_MSAA(ThreadContext& ctx, const std:
 
 			if(bsdf->IsLightingBsdf())
 			{
-				color *= bsdf->ComputeIndirectIllumination(ctx, bsdfEntry->view);
+				color *= bsdf->ComputeIndirectIllumination(ctx, bsdfEntry->view, ctx.indirectRays.data() + nextRay, ctx.indirectEstimates.data() + nextRay);
+				nextRay += bsdf->GetSettings().subSamples;
 			}
 			
 			if(bsdf->IsCausticBsdf())
 			{
 				hasCaustic = true;
-				color *= bsdf->GetMaterial()->ShadeSurface(bsdfEntry->view);
+				color *= bsdf->GetMaterial()->ShadeSurface(ctx, bsdfEntry->view);
 			}
 			
 			if(!hasCaustic)
-				color *= bsdf->GetMaterial()->ShadeSurface(bsdfEntry->view);
+				color *= bsdf->GetMaterial()->ShadeSurface(ctx, bsdfEntry->view);
 		}
 
 		pixel += WeightedPixel(1, color);
@@ -59,20 +85,33 @@ Pixel RayTracer::ComputeIndirectIllumination_MSAA(ThreadContext& ctx, const std:
 	return (Pixel)pixel;
 }
 
-Pixel BSDF::ComputeIndirectIllumination(ThreadContext& ctx, const PathSegment& view) const
+void BSDF::SampleIndirectIllumination(ThreadContext& ctx, const PathSegment& view, std::vector<PathSegment>& outRays) const
 {
-	WeightedPixel color;
-
 	for(int i = 0; i < GetSettings().subSamples; i++)
 	{
 		// sample hemisphere
 		PathSegment segment = view;
-		Pixel estimate;
 
 		segment.SetOrigin(view.GetImpact());
 		segment.SetTriangleAtOrigin(view.GetTriangleAtImpact());
-		segment.SetDirection(Math::GetRandomVectorInUnitHalfSphere(view.GetNormalAtImpact()));//GetHemisphereSample(view));
-		segment.SetColor(ctx.GetTracer()->EstimateIndirectIllumination(ctx, segment));
+		float uv[2];
+		ctx.sampler->Get2D(ESampleDimension::Hemisphere, uv);
+		segment.SetDirection(Math::MapToUnitHalfSphere(view.GetNormalAtImpact(), uv[0], uv[1]));//GetHemisphereSample(view));
+
+		outRays.push_back(segment);
+	}
+}
+
+Pixel BSDF::ComputeIndirectIllumination(ThreadContext& ctx, const PathSegment& view, const PathSegment* tracedRays, const Pixel* estimates) const
+{
+	WeightedPixel color;
+
+	for(int i = 0; i < GetSettings().subSamples; i++)
+	{
+		PathSegment segment = tracedRays[i];
+
+		segment.ResetImpact();
+		segment.SetColor(estimates[i]);
 		segment.SetImpact(segment.GetOrigin() + segment.GetDirection());
 
 		PathSegment incomingLight = PathSegment::Inverse(segment);
@@ -89,17 +128,36 @@ Pixel BSDF::ComputeIndirectIllumination(ThreadContext& ctx, const PathSegment& v
 	return res;
 }
 
-Pixel RayTracer::EstimateIndirectIllumination(ThreadContext& ctx, const PathSegment& viewOriginal) const
+void RayTracer::EstimateIndirectIllumination(ThreadContext& ctx, const PathSegment* views, int count, Pixel* outEstimates) const
 {
-	BSDF* bsdf;
-	Pixel result;
-	PathSegment view = viewOriginal;
+	// follow all views through transmissive materials first, so their photon searches form one batch
+	ctx.estimatePoints.clear();
+	ctx.estimateTargets.clear();
+
+	for(int i = 0; i < count; i++)
+	{
+		PathSegment view = views[i];
+
+		outEstimates[i] = Pixel();
+
+		// a live ray without impact was traced and left the scene, all others continue from their first impact
+		if(!view.HasImpact() && view.CanBounceAgain())
+		{
+			outEstimates[i] = ctx.GetClearColor();
+		}
+		else if(ctx.FollowTransmissive(view, &outEstimates[i]))
+		{
+			ctx.estimatePoints.push_back(view.GetImpact());
+			ctx.estimateTargets.push_back(i);
+		}
+	}
+
+	// find nearest photons
+	ctx.SamplePhotons(ctx.GetIndirectMap(), ctx.estimatePoints.data(), (int)ctx.estimatePoints.size(), GetSettings().indirectSmoothingSamples);
 
-	if(ctx.FollowTransmissive(view, &result, &bsdf))
+	for(size_t i = 0; i < ctx.estimateTargets.size(); i++)
 	{
-		// find nearest photon
-		ctx.GetIndirectMap().Sample(view.GetImpact(), GetSettings().indirectSmoothingSamples, ctx.samples);
-		PathSegment* photon = ctx.samples.Select();
+		PathSegment* photon = ctx.batchSamples[i].Select(ctx.random);
 
 		// estimate local illumination around photon
 		if(!photon->HasLocalIllumination())
@@ -107,8 +165,15 @@ Pixel RayTracer::EstimateIndirectIllumination(ThreadContext& ctx, const PathSegm
 			photon->SetLocalIllumination(photon->GetMaterialAtImpact()->ComputeLocalIllumination(ctx, *photon));
 		}
 
-		result = photon->GetLocalIllumination();
+		outEstimates[ctx.estimateTargets[i]] = photon->GetLocalIllumination();
 	}
+}
+
+Pixel RayTracer::EstimateIndirectIllumination(ThreadContext& ctx, const PathSegment& view) const
+{
+	Pixel result;
+
+	EstimateIndirectIllumination(ctx, &view, 1, &result);
 
 	return result;
 }
@@ -125,7 +190,7 @@ Pixel BSDFMaterial::ComputeLocalIllumination(ThreadContext& ctx, const PathSegme
 
 		if(ctx.FollowTransmissive(view, &result, &bsdf))
 		{
-			ctx.GetIndirectMap().Sample(view.GetImpact(), GetSettings().indirectLocalSamples, ctx.samples);
+			ctx.SamplePhotons(ctx.GetIndirectMap(), view.GetImpact(), GetSettings().indirectLocalSamples);
 
 			result += WeightedPixel(1, bsdf->ComputeLocalIllumination(ctx, view));
 		}
@@ -139,6 +204,8 @@ Pixel BSDF::ComputeLocalIllumination(ThreadContext& ctx, const PathSegment& view
 	WeightedPixel result;
 	float sampleCount = 0;
 
+	ctx.stats.bsdfEvaluations[EBsdfEvaluation::LocalIllumination]++;
+
 	for(PathSegment* sample : ctx.samples)
 	{
 		PathSegment mutatedLight;
@@ -148,8 +215,7 @@ Pixel BSDF::ComputeLocalIllumination(ThreadContext& ctx, const PathSegment& view
 			// direct light hit - get path from light source to viewer
 			mutatedLight.SetOrigin(sample->GetOrigin());
 			mutatedLight.SetDirection(Math::Normalized(viewer.GetImpact() - sample->GetOrigin()));
-			mutatedLight.SetImpact(viewer.GetImpact());
-			mutatedLight.SetTriangleAtImpact(viewer.GetTriangleAtImpact());
+			mutatedLight.CopyImpact(viewer);
 			mutatedLight.SetTriangleAtOrigin(sample->GetTriangleAtOrigin());
 			mutatedLight.SetColor(sample->GetColor() * GetSettings().indirectLightAmplifier);
 			mutatedLight.SetWeight(1);
@@ -167,7 +233,22 @@ Pixel BSDF::ComputeLocalIllumination(ThreadContext& ctx, const PathSegment& view
 		const float weight = mutatedLight.GetWeight();
 		Pixel color;
 
-		if(ctx.FollowTransmissive(mutatedLight, &color, &bsdf))
+		if(!ctx.GetTracer()->HasCausticMaterials() && mutatedLight.CanBounceAgain())
+		{
+			// the mutated path counts only if it arrives at the viewer, which is an occlusion query without transmissive layers
+			if(!ctx.IsSegmentVisible(mutatedLight.GetOrigin(), mutatedLight.GetTriangleAtOrigin(), viewer.GetImpact(), ERayKind::Indirect, GetSettings().indirectLightTolerance))
+				continue;
+
+			// same state the transmissive walk would leave behind
+			mutatedLight.CopyImpact(viewer);
+			mutatedLight.SetColor(Pixel(1,1,1));
+
+			bsdf = viewer.GetMaterialAtImpact()->SelectBSDF(ctx, mutatedLight);
+
+			result += WeightedPixel(1, bsdf->ComputeDirectIllumination(ctx, viewer, mutatedLight) * bsdf->GetMaterial()->ShadeSurface(ctx, viewer));
+			ctx.stats.bsdfEvaluations[EBsdfEvaluation::DirectIllumination]++;
+		}
+		else if(ctx.FollowTransmissive(mutatedLight, &color, &bsdf))
 		{
 			// is impact near viewer?
 			if((mutatedLight.GetMeshAtImpact() != viewer.GetMeshAtImpact()) ||
@@ -177,7 +258,8 @@ Pixel BSDF::ComputeLocalIllumination(ThreadContext& ctx, const PathSegment& view
 			}
 			else
 			{
-				result += WeightedPixel(1, bsdf->ComputeDirectIllumination(ctx, viewer, mutatedLight) * bsdf->GetMaterial()->ShadeSurface(viewer));
+				result += WeightedPixel(1, bsdf->ComputeDirectIllumination(ctx, viewer, mutatedLight) * bsdf->GetMaterial()->ShadeSurface(ctx, viewer));
+				ctx.stats.bsdfEvaluations[EBsdfEvaluation::DirectIllumination]++;
 			}
 		}
 		else
@@ -15,11 +15,16 @@ RenderSettings RenderSettings::Empty()
 	res.indirectLightAmplifier = -1;
 	res.indirectLightTolerance = -1;
 	res.qualityPreset = "";
+	res.sampler = "";
+	res.accel = "";
+	res.triangleLayout = "";
+	res.photonLookup = "";
 	res.photonIntensity = -1;
 	res.emissiveIntensity = -1;
 	res.resolution = -1;
 	res.threadCount = -1;
 	res.noPreview = false;
+	res.noBvhCache = false;
 	res.shadowSampleFactor = -1;
 	res.shadowSamples = -1;
 	res.indirectLocalSamples = -1;
@@ -30,10 +35,18 @@ RenderSettings RenderSettings::Empty()
 void RenderSettings::ApplyDefaults(const RenderSettings& defaults)
 {
 	noPreview = defaults.noPreview;
+	noBvhCache = defaults.noBvhCache;
 	qualityPreset = defaults.qualityPreset;
 	inputFile = defaults.inputFile;
 	outputFile = defaults.outputFile;
+	benchmarkFile = defaults.benchmarkFile;
+	syntheticScene = defaults.syntheticScene;
+	statsFile = defaults.statsFile;
 
+	if(sampler.empty()) sampler = defaults.sampler;
+	if(accel.empty()) accel = defaults.accel;
+	if(triangleLayout.empty()) triangleLayout = defaults.triangleLayout;
+	if(photonLookup.empty()) photonLookup = defaults.photonLookup;
 	if(msaaSamples < 0) msaaSamples = defaults.msaaSamples;
 	if(subSamples < 0) subSamples = defaults.subSamples;
 	if(photonCount < 0) photonCount = defaults.photonCount;
@@ -59,6 +72,11 @@ void RenderSettings::Initialize(std::string qualityPreset)
 	shadowSampleFactor = 0.25f;
 	subSamples = 8;
 	noPreview = false;
+	noBvhCache = false;
+	sampler = "sobol";
+	accel = "default";
+	triangleLayout = "default";
+	photonLookup = "kdtree";
 	threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1);
 	indirectLightAmplifier = 2;
 	indirectLightTolerance = 0.0001f;
@@ -118,7 +136,7 @@ void RenderSettings::Initialize(std::string qualityPreset)
 
 bool RenderSettings::MakeValid()
 {
-	threadCount = std::max(1, std::min(threadCount, 64));
+	threadCount = std::max(1, threadCount);
 	msaaSamples = std::min(1024, std::max(msaaSamples, 1));
 	indirectLocalSamples = std::min(1024, std::max(indirectLocalSamples, 1));
 	shadowSamples = std::min(1024, std::max(shadowSamples, 1));
@@ -131,6 +149,67 @@ bool RenderSettings::MakeValid()
 	photonIntensity = std::max(0.001f, std::min(photonIntensity, 1000.0f));
 	emissiveIntensity = std::max(0.001f, std::min(emissiveIntensity, 1000.0f));
 
+	if((sampler != "sobol") && (sampler != "halton") && (sampler != "random"))
+	{
+		std::cerr << "[WARNING]: Unrecognized sampler \"" << sampler << "\". Switching to \"sobol\"." << std::endl;
+		sampler = "sobol";
+	}
+
+	const std::vector<std::string> accels = { "default", "bvh2", "bvh2.objectsplit", "bvh2.spatialsplit", "bvh4", "bvh4.objectsplit", "bvh4.spatialsplit", "bvh4mb", "bvh4mb.objectsplit", "bvh4c" };
+
+	if(std::find(accels.begin(), accels.end(), accel) == accels.end())
+	{
+		std::cerr << "[WARNING]: Unrecognized acceleration structure \"" << accel << "\". Switching to \"default\"." << std::endl;
+		accel = "default";
+	}
+
+	// layout is "<triangle type>[.<intersector>]"
+	const std::vector<std::string> layouts = { "default", "triangle1", "triangle1i", "triangle1v", "triangle4", "triangle4i", "triangle4v", "triangle8" };
+	const std::vector<std::string> intersectors = { "default", "fast", "accurate", "moeller", "pluecker" };
+	const size_t dot = triangleLayout.find('.');
+
+	if((std::find(layouts.begin(), layouts.end(), triangleLayout.substr(0, dot)) == layouts.end()) ||
+		((dot != std::string::npos) && (std::find(intersectors.begin(), intersectors.end(), triangleLayout.substr(dot + 1)) == intersectors.end())))
+	{
+		std::cerr << "[WARNING]: Unrecognized triangle layout \"" << triangleLayout << "\". Switching to \"default\"." << std::endl;
+		triangleLayout = "default";
+	}
+
+	// Pluecker intersectors only exist for the "v" and "i" layouts, which store or index the vertices
+	const std::string layoutType = triangleLayout.substr(0, triangleLayout.find('.'));
+	const std::string layoutIntersector = (triangleLayout.find('.') != std::string::npos) ? triangleLayout.substr(triangleLayout.find('.') + 1) : "default";
+
+	if(((layoutIntersector == "pluecker") || (layoutIntersector == "accurate")) && (layoutType.back() != 'v') && (layoutType.back() != 'i'))
+	{
+		std::cerr << "[WARNING]: Triangle layout \"" << layoutType << "\" has no \"" << layoutIntersector << "\" intersector. Switching to \"default\"." << std::endl;
+		triangleLayout = "default";
+	}
+
+	if((accel.compare(0, 6, "bvh4mb") == 0) && (triangleLayout.substr(0, triangleLayout.find('.')) != "default") && (triangleLayout.substr(0, triangleLayout.find('.')) != "triangle4i"))
+	{
+		std::cerr << "[WARNING]: \"" << accel << "\" only supports the \"triangle4i\" layout. Switching to \"triangle4i\"." << std::endl;
+		triangleLayout = "triangle4i";
+	}
+
+	// the compressed BVH stores its own indexed triangles and only has a Moeller-Trumbore intersector
+	const std::vector<std::string> compressedLayouts = { "default", "default.default", "default.fast", "default.moeller" };
+
+	if((accel == "bvh4c") && (std::find(compressedLayouts.begin(), compressedLayouts.end(), triangleLayout) == compressedLayouts.end()))
+	{
+		std::cerr << "[WARNING]: \"bvh4c\" only supports the \"default\" layout. Switching to \"default\"." << std::endl;
+		triangleLayout = "default";
+	}
+
+	if((photonLookup != "kdtree") && (photonLookup != "grid"))
+	{
+		std::cerr << "[WARNING]: Unrecognized photon lookup \"" << photonLookup << "\". Switching to \"kdtree\"." << std::endl;
+		photonLookup = "kdtree";
+	}
+
+	// only the BVH4 variants can be written to disk, everything else is silently rebuilt on every run
+	if((accel != "default") && (accel.compare(0, 4, "bvh4") != 0 || accel.compare(0, 6, "bvh4mb") == 0))
+		noBvhCache = true;
+
 #ifdef _DEBUG
 	shadowSampleFactor = 0.25f;
 	shadowSamples = 32;
@@ -144,14 +223,17 @@ bool RenderSettings::MakeValid()
 
 #endif
 
-	if(inputFile.empty())
+	if(inputFile.empty() && syntheticScene.empty())
 	{
 		std::cerr << "[ERROR]: Input file was not specified!" << std::endl;
 		return false;
 	}
 
+	if(!inputFile.empty() && !syntheticScene.empty())
+		std::cerr << "[WARNING]: Both an input file and a synthetic scene were specified. Using the synthetic scene." << std::endl;
+
 	if(outputFile.empty())
-		outputFile = inputFile + ".exr";
+		outputFile = (syntheticScene.empty() ? inputFile : "synthetic") + ".exr";
 
 	return true;
 }
\ No newline at end of file
@@ -23,7 +23,9 @@ namespace EPixelPerfMon
 		None = 0,
 		Direct = 1,
 		Indirect = 2,
-		Total = 4
+		Total = 4,
+		/** Adaptive passes, rays and kNN queries per pixel. */
+		Counts = 8,
 	};
 };
 
@@ -50,13 +52,21 @@ public:
 	float indirectLightAmplifier;
 	float indirectLightTolerance;
 	std::string qualityPreset;
+	std::string sampler;
+	std::string accel;
+	std::string triangleLayout;
+	std::string photonLookup;
 	float photonIntensity;
 	float emissiveIntensity;
 	int resolution;
 	int threadCount;
 	std::string outputFile;
 	std::string inputFile;
+	std::string benchmarkFile;
+	std::string syntheticScene;
+	std::string statsFile;
 	bool noPreview;
+	bool noBvhCache;
 	float shadowSampleFactor;
 	int shadowSamples;
 	int pixelPerfMonMask;
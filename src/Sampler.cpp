@@ -0,0 +1,113 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "stdafx.h"
+
+std::shared_ptr<Sampler> Sampler::Create(const std::string& name)
+{
+	if(name == "sobol")
+		return std::make_shared<SobolSampler>();
+	else if(name == "halton")
+		return std::make_shared<HaltonSampler>();
+	else if(name == "random")
+		return std::make_shared<RandomSampler>();
+	else
+		throw std::invalid_argument("Unknown sampler \"" + name + "\".");
+}
+
+void Sampler::StartPixel(uint32_t pixelIndex)
+{
+	random.Seed(ERandomStream::Sampler, pixelIndex, 0);
+
+	for(int i = 0; i < ESampleDimension::Count; i++)
+	{
+		indices[i] = 0;
+		scrambles[i][0] = random.NextUInt();
+		scrambles[i][1] = random.NextUInt();
+	}
+}
+
+float Sampler::Get1D(int dimension)
+{
+	if((dimension < 0) || (dimension >= ESampleDimension::Count))
+		return random.NextFloat();
+
+	return Sample1D(indices[dimension]++, scrambles[dimension]);
+}
+
+void Sampler::Get2D(int dimension, float* outUV)
+{
+	if((dimension < 0) || (dimension >= ESampleDimension::Count))
+	{
+		random.NextFloats(outUV, 2);
+		return;
+	}
+
+	Sample2D(indices[dimension]++, scrambles[dimension], outUV);
+}
+
+float SobolSampler::Sample1D(uint32_t index, const uint32_t* scramble)
+{
+	return VanDerCorputSequence::ToUnitFloat(VanDerCorputSequence::RadicalInverse(index, scramble[0]));
+}
+
+void SobolSampler::Sample2D(uint32_t index, const uint32_t* scramble, float* outUV)
+{
+	outUV[0] = VanDerCorputSequence::ToUnitFloat(VanDerCorputSequence::RadicalInverse(index, scramble[0]));
+	outUV[1] = VanDerCorputSequence::ToUnitFloat(VanDerCorputSequence::Sobol2(index, scramble[1]));
+}
+
+static float RadicalInverse3(uint32_t index)
+{
+	const double invBase = 1.0 / 3.0;
+	double invBaseN = invBase;
+	double result = 0;
+
+	for(; index > 0; index /= 3)
+	{
+		result += (index % 3) * invBaseN;
+		invBaseN *= invBase;
+	}
+
+	return (float)std::min(result, 0.99999994);
+}
+
+static float RotateUnitFloat(float value, uint32_t offset)
+{
+	value += VanDerCorputSequence::ToUnitFloat(offset);
+	return (value >= 1) ? value - 1 : value;
+}
+
+float HaltonSampler::Sample1D(uint32_t index, const uint32_t* scramble)
+{
+	return RotateUnitFloat(VanDerCorputSequence::ToUnitFloat(VanDerCorputSequence::RadicalInverse(index)), scramble[0]);
+}
+
+void HaltonSampler::Sample2D(uint32_t index, const uint32_t* scramble, float* outUV)
+{
+	outUV[0] = RotateUnitFloat(VanDerCorputSequence::ToUnitFloat(VanDerCorputSequence::RadicalInverse(index)), scramble[0]);
+	outUV[1] = RotateUnitFloat(RadicalInverse3(index), scramble[1]);
+}
+
+float RandomSampler::Sample1D(uint32_t index, const uint32_t* scramble)
+{
+	return random.NextFloat();
+}
+
+void RandomSampler::Sample2D(uint32_t index, const uint32_t* scramble, float* outUV)
+{
+	random.NextFloats(outUV, 2);
+}
@@ -0,0 +1,112 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef _SAMPLER_H_
+#define _SAMPLER_H_
+
+/*
+	Sample dimensions consumed during screen sampling. Every dimension (or dimension pair
+	for 2D samples) is its own independently scrambled low-discrepancy sequence with its own
+	sample counter, so each call site consumes a well stratified sequence no matter how many
+	samples other call sites took in between ("padded" sampling). A dimension must only ever
+	be used by one kind of decision, otherwise consecutive points of the same sequence would
+	be split among different decisions and lose their stratification.
+*/
+namespace ESampleDimension
+{
+	enum
+	{
+		/** 2D, MSAA sample position inside the pixel during direct passes. */
+		MsaaDirect = 0,
+		/** 2D, MSAA sample position inside the pixel during indirect passes. */
+		MsaaIndirect = 1,
+		/** 2D, hemisphere direction in BSDF::SampleIndirectIllumination(). */
+		Hemisphere = 2,
+		/** 1D, caustic and lighting BSDF selection per camera path vertex. */
+		BsdfSelection = 3,
+
+		/** Camera path vertices beyond this depth select their BSDFs with plain random numbers. */
+		MaxSelectionDepth = 4,
+		Count = BsdfSelection + 2 * MaxSelectionDepth,
+	};
+
+	inline int CausticSelection(int depth) { return BsdfSelection + 2 * depth + 0; }
+	inline int LightingSelection(int depth) { return BsdfSelection + 2 * depth + 1; }
+};
+
+/*
+	Source of sample points for screen sampling. A sampler is owned by a ThreadContext
+	and restarted for every pixel via StartPixel(). All scrambling is derived from the
+	pixel index only, so results are independent of the thread layout.
+*/
+class Sampler
+{
+protected:
+	uint32_t indices[ESampleDimension::Count];
+	uint32_t scrambles[ESampleDimension::Count][2];
+	RandomGenerator random;
+
+	virtual float Sample1D(uint32_t index, const uint32_t* scramble) = 0;
+	virtual void Sample2D(uint32_t index, const uint32_t* scramble, float* outUV) = 0;
+
+public:
+	virtual ~Sampler() { }
+
+	/** Creates the sampler selected by "name" ("sobol", "halton" or "random"). */
+	static std::shared_ptr<Sampler> Create(const std::string& name);
+
+	void StartPixel(uint32_t pixelIndex);
+
+	/** Next sample of a 1D dimension, uniformly distributed in [0, 1). */
+	float Get1D(int dimension);
+
+	/** Next sample of a 2D dimension, both coordinates uniformly distributed in [0, 1). */
+	void Get2D(int dimension, float* outUV);
+};
+
+/*
+	Sobol (0,2)-sequence with random digit scrambling (Kollig & Keller, "Efficient
+	Multidimensional Sampling"). Every power of two prefix is perfectly stratified, so
+	MSAA and sub-sample counts should preferably be powers of two.
+*/
+class SobolSampler : public Sampler
+{
+protected:
+	virtual float Sample1D(uint32_t index, const uint32_t* scramble);
+	virtual void Sample2D(uint32_t index, const uint32_t* scramble, float* outUV);
+};
+
+/*
+	Halton sequence in bases 2 and 3, randomized by a Cranley-Patterson rotation. Unlike
+	the Sobol sampler it stratifies equally well for any sample count.
+*/
+class HaltonSampler : public Sampler
+{
+protected:
+	virtual float Sample1D(uint32_t index, const uint32_t* scramble);
+	virtual void Sample2D(uint32_t index, const uint32_t* scramble, float* outUV);
+};
+
+/** Plain independent random numbers, mainly to compare against the low-discrepancy samplers. */
+class RandomSampler : public Sampler
+{
+protected:
+	virtual float Sample1D(uint32_t index, const uint32_t* scramble);
+	virtual void Sample2D(uint32_t index, const uint32_t* scramble, float* outUV);
+};
+
+#endif
@@ -15,17 +15,22 @@
 // ======================================================================== //
 
 
-class Mesh
+class Mesh : public std::enable_shared_from_this<Mesh>
 {
 	friend class RayTracer;
 	friend struct Triangle;
 	friend class UnityImporter;
+	friend class SyntheticScene;
 private:
 	std::vector<Vertex> vertices;
 	std::vector<Triangle> triangles;
 	std::shared_ptr<BSDFMaterial> material;
 	std::shared_ptr<LightSource> light;
+	std::shared_ptr<Mesh> prototype;
+	Matrix4x4 transform;
+	std::map<UnifiedSettings*, std::shared_ptr<BSDFMaterial>> instanceMaterials;
 public:
+	Mesh() : transform(Matrix4x4::identity()) { }
 
 	LightSource* GetLight() const { return light.get(); }
 	void SetLight(std::shared_ptr<LightSource> light) { this->light = light; }
@@ -36,18 +41,33 @@ public:
 	boost::iterator_range<std::vector<Vertex>::iterator> GetVertices() { return boost::make_iterator_range(vertices.begin(), vertices.end()); }
 	boost::iterator_range<std::vector<Triangle>::iterator> GetTriangles() { return boost::make_iterator_range(triangles.begin(), triangles.end()); }
 
+	/** The mesh whose object space vertices this instance shares, nullptr if it owns world space vertices. */
+	const Mesh* GetPrototype() const { return prototype.get(); }
+	/** Object to world transform of an instance, identity otherwise. */
+	const Matrix4x4& GetTransform() const { return transform; }
+
+	// world space vertex attributes, transformed on the fly for instances
+	int GetVertexCount() const { return (int)(prototype ? prototype->vertices.size() : vertices.size()); }
+	Vector3 GetVertexPosition(int index) const { return prototype ? Math::TransformVector(transform, prototype->vertices[index].position) : vertices[index].position; }
+	Vector3 GetVertexNormal(int index) const { return prototype ? Math::TransformDirection(transform, prototype->vertices[index].normal) : vertices[index].normal; }
+	Vector3 GetVertexTexCoord(int index) const { return prototype ? prototype->vertices[index].matUv : vertices[index].matUv; }
+
+	/*
+		Places this mesh with "transform". The instance shares the vertices of this mesh instead
+		of copying them, and all instances with the same material template share one BSDFMaterial.
+	*/
 	std::shared_ptr<Mesh> Instanciate(Matrix4x4 transform, std::shared_ptr<UnifiedSettings> material);
 };
 
 class LightSource
 {
 private:
-	float photonMultiplier, intensity;
+	float photonMultiplier, intensity, photonScale;
+	double area;
 	std::string name;
 	int index;
 	std::shared_ptr<Mesh> mesh;
-	std::map<double, const Triangle*> probToTriangle;
-	double maximumProbability;
+	AliasTable triangleByArea;
 	Pixel color;
 	std::shared_ptr<TextureMap> texture;
 	bool isDirectional;
@@ -66,6 +86,15 @@ public:
 	float GetIntensity() const { return intensity; }
 	void SetIntensity(float value) { intensity = value; }
 
+	/** Total surface area of the emitting mesh. */
+	double GetArea() const { return area; }
+	/** Emitted power the photon budget is split by. */
+	double GetPower() const { return intensity * area * photonMultiplier; }
+
+	/** Energy multiplier of every emitted photon, compensating for the light's share of the photon budget. */
+	float GetPhotonScale() const { return photonScale; }
+	void SetPhotonScale(float value) { photonScale = value; }
+
 	bool IsDirectional() const { return isDirectional; }
 	void SetDirectional(bool value) { isDirectional = value; }
 
@@ -75,7 +104,11 @@ public:
 	const TextureMap& GetTexture() const { return *texture.get(); }
 	void SetTexture(std::shared_ptr<TextureMap> value) { texture = value; }
 
-	bool EmitPhoton(ThreadContext& ctx) const;
+	/*
+		Emits photon "sample" of a batch of "sampleCount" photons from a triangle chosen proportional
+		to its area. The samples of a batch are stratified over the light's surface.
+	*/
+	bool EmitPhoton(ThreadContext& ctx, int sample, int sampleCount) const;
 };
 
 class Scene
@@ -89,6 +122,9 @@ protected:
 	virtual ~Scene() { }
 public:
 
+	/** Loads the input file of "settings", or generates a SyntheticScene if one was requested instead. */
+	static std::shared_ptr<Scene> FromSettings(const RenderSettings& settings);
+
 	boost::iterator_range<std::vector<Camera>::iterator> GetCameras() { return boost::make_iterator_range(cameras.begin(), cameras.end()); }
 	boost::iterator_range<std::vector<std::shared_ptr<Mesh>>::iterator> GetMeshes() { return boost::make_iterator_range(meshes.begin(), meshes.end()); }
 	boost::iterator_range<std::vector<LightSource*>::iterator> GetLights() { return boost::make_iterator_range(lights.begin(), lights.end()); }
@@ -0,0 +1,148 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#include "stdafx.h"
+
+static double ToSeconds(const StopWatch& watch)
+{
+	return std::chrono::duration<double>(watch.GetElapsed()).count();
+}
+
+StageSweep StageBenchmark::RunOnce(int threadCount)
+{
+	RenderSettings runSettings = settings;
+	StageSweep sweep;
+	StopWatch watch;
+
+	runSettings.threadCount = threadCount;
+	runSettings.pixelDebugMask = EPixelDebug::None;
+	runSettings.pixelPerfMonMask = EPixelPerfMon::None;
+	runSettings.noBvhCache = true; // every sweep has to measure a full build
+	sweep.threadCount = threadCount;
+
+	std::cerr << "Benchmarking with " << threadCount << " thread(s)..." << std::endl;
+
+	// scene loading is single threaded, but part of the end-to-end picture
+	StageResult load("Load");
+	auto scene = Scene::FromSettings(runSettings);
+	load.seconds = ToSeconds(watch);
+	sweep.stages.push_back(load);
+
+	StageResult init("Initialize"), bvh("BuildBVH");
+	watch.Reset();
+	RayTracer rayTracer(scene, runSettings);
+	init.seconds = ToSeconds(watch);
+	bvh.seconds = rayTracer.GetBVHBuildSeconds();
+	sweep.stages.push_back(init);
+	sweep.stages.push_back(bvh);
+
+	StageResult tracing("TracePhotons");
+	watch.Reset();
+	rayTracer.TracePhotons();
+	tracing.seconds = ToSeconds(watch);
+	tracing.rays = rayTracer.GetStageStats().back().stats.GetRaysCast();
+	tracing.photons = rayTracer.GetIndirectMap().GetRegisteredPhotonCount();
+	sweep.stages.push_back(tracing);
+
+	StageResult building("BuildPhotonMaps");
+	watch.Reset();
+	rayTracer.BuildPhotonMaps();
+	building.seconds = ToSeconds(watch);
+	building.photons = 
+		(int64_t)rayTracer.GetIndirectMap().GetRegisteredPhotonCount() +
+		rayTracer.GetDirectMap().GetRegisteredPhotonCount() +
+		rayTracer.GetCausticsMap().GetRegisteredPhotonCount();
+	sweep.stages.push_back(building);
+
+	StageResult sampling("SamplePhotonsFromScreen");
+	watch.Reset();
+	rayTracer.SamplePhotonsFromScreen();
+	sampling.seconds = ToSeconds(watch);
+	const ThreadStats& stats = rayTracer.GetStageStats().back().stats;
+	sampling.rays = stats.GetRaysCast();
+	sampling.photonQueries = stats.photonQueries;
+	sweep.stages.push_back(sampling);
+
+	return sweep;
+}
+
+void StageBenchmark::Run()
+{
+	sweeps.clear();
+
+	for(int threads = 1; ; threads = std::min(threads * 2, settings.threadCount))
+	{
+		sweeps.push_back(RunOnce(threads));
+
+		if(threads >= settings.threadCount)
+			break;
+	}
+}
+
+void StageBenchmark::WriteStageJSON(std::ostream& out, const StageResult& stage, const StageResult* reference, int threadCount)
+{
+	const double seconds = std::max(stage.seconds, 1e-9);
+
+	out << "{ \"name\": \"" << stage.name << "\", \"seconds\": " << stage.seconds;
+
+	if(stage.rays > 0) out << ", \"rays\": " << stage.rays << ", \"rays_per_second\": " << (stage.rays / seconds);
+	if(stage.photons > 0) out << ", \"photons\": " << stage.photons << ", \"photons_per_second\": " << (stage.photons / seconds);
+	if(stage.photonQueries > 0) out << ", \"knn_queries\": " << stage.photonQueries << ", \"knn_queries_per_second\": " << (stage.photonQueries / seconds);
+
+	if(reference)
+	{
+		out << ", \"speedup\": " << (reference->seconds / seconds)
+			<< ", \"parallel_efficiency\": " << (reference->seconds / (threadCount * seconds));
+	}
+
+	out << " }";
+}
+
+void StageBenchmark::WriteJSON(std::ostream& out) const
+{
+	out << "{" << std::endl;
+	out << "  \"input_file\": \"" << boost::replace_all_copy(settings.inputFile, "\\", "\\\\") << "\"," << std::endl;
+	out << "  \"synthetic_scene\": \"" << settings.syntheticScene << "\"," << std::endl;
+	out << "  \"resolution\": " << settings.resolution << "," << std::endl;
+	out << "  \"photons\": " << settings.photonCount << "," << std::endl;
+	out << "  \"sweeps\": [" << std::endl;
+
+	for(size_t i = 0; i < sweeps.size(); i++)
+	{
+		const auto& sweep = sweeps[i];
+
+		out << "    {" << std::endl;
+		out << "      \"threads\": " << sweep.threadCount << "," << std::endl;
+		out << "      \"stages\": [" << std::endl;
+
+		for(size_t j = 0; j < sweep.stages.size(); j++)
+		{
+			// efficiency is relative to the single threaded run, which always comes first
+			const StageResult* reference = (sweeps.front().threadCount == 1) ? &sweeps.front().stages[j] : nullptr;
+
+			out << "        ";
+			WriteStageJSON(out, sweep.stages[j], reference, sweep.threadCount);
+			out << ((j + 1 < sweep.stages.size()) ? "," : "") << std::endl;
+		}
+
+		out << "      ]" << std::endl;
+		out << "    }" << ((i + 1 < sweeps.size()) ? "," : "") << std::endl;
+	}
+
+	out << "  ]" << std::endl;
+	out << "}" << std::endl;
+}
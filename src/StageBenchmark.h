@@ -0,0 +1,62 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef _STAGEBENCHMARK_H_
+#define _STAGEBENCHMARK_H_
+
+struct StageResult
+{
+	std::string name;
+	double seconds;
+	int64_t rays;
+	int64_t photons;
+	int64_t photonQueries;
+
+	StageResult(std::string name) : name(name), seconds(0), rays(0), photons(0), photonQueries(0) { }
+};
+
+struct StageSweep
+{
+	int threadCount;
+	std::vector<StageResult> stages;
+};
+
+/*
+	Runs the whole pipeline (scene loading, BVH build, photon tracing, photon map build and
+	screen sampling) once per thread count, doubling from one up to "threadCount" of the
+	given settings. Reports per stage wall time, throughput and parallel efficiency, which
+	is the single threaded time divided by "threads * time".
+*/
+class StageBenchmark
+{
+private:
+	RenderSettings settings;
+	std::vector<StageSweep> sweeps;
+
+	StageSweep RunOnce(int threadCount);
+
+	static void WriteStageJSON(std::ostream& out, const StageResult& stage, const StageResult* reference, int threadCount);
+
+public:
+	StageBenchmark(const RenderSettings& settings) : settings(settings) { }
+
+	void Run();
+
+	void WriteJSON(std::ostream& out) const;
+};
+
+#endif
@@ -0,0 +1,396 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "stdafx.h"
+
+SyntheticSceneOptions SyntheticSceneOptions::Parse(std::string spec)
+{
+	SyntheticSceneOptions options;
+	std::vector<std::string> entries;
+
+	boost::split(entries, spec, boost::algorithm::is_any_of(","));
+
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		std::string key = boost::trim_copy(entries[i]), value;
+		size_t separator = key.find('=');
+
+		if(key.empty())
+			continue;
+
+		if(separator == std::string::npos)
+		{
+			if(i > 0)
+				throw std::invalid_argument("Synthetic scene option \"" + key + "\" has no value.");
+
+			options.variant = key;
+			continue;
+		}
+
+		value = key.substr(separator + 1);
+		key = key.substr(0, separator);
+
+		try
+		{
+			if(key == "variant") options.variant = value;
+			else if(key == "clutter") options.clutterTriangles = std::stoi(value);
+			else if(key == "instances") options.instances = std::stoi(value);
+			else if(key == "triangles")
+			{
+				// allows "1e8", values outside of int would make the conversion undefined
+				const double triangles = std::stod(value);
+
+				if(!(std::abs(triangles) <= std::numeric_limits<int>::max()))
+					throw std::out_of_range("Synthetic scene option \"triangles\" is out of range.");
+
+				options.triangles = (int)triangles;
+			}
+			else if(key == "emissive") options.emissiveMeshes = std::stoi(value);
+			else if(key == "glass") options.glassLayers = std::stoi(value);
+			else if(key == "seed") options.seed = (uint32_t)std::stoul(value);
+			else throw std::invalid_argument("Unknown synthetic scene option \"" + key + "\".");
+		}
+		catch(const std::logic_error&)
+		{
+			throw std::invalid_argument("Invalid value \"" + value + "\" for synthetic scene option \"" + key + "\".");
+		}
+	}
+
+	if((options.variant != "cornell") && (options.variant != "empty") && (options.variant != "open"))
+		throw std::invalid_argument("Unknown synthetic scene variant \"" + options.variant + "\".");
+
+	if((options.clutterTriangles < 0) || (options.instances < 0) || (options.triangles < 0) || (options.emissiveMeshes < 0) || (options.glassLayers < 0))
+		throw std::invalid_argument("Synthetic scene options must not be negative.");
+
+	return options;
+}
+
+std::shared_ptr<Scene> Scene::FromSettings(const RenderSettings& settings)
+{
+	if(!settings.syntheticScene.empty())
+		return std::make_shared<SyntheticScene>(SyntheticSceneOptions::Parse(settings.syntheticScene));
+	else
+		return std::make_shared<UnityImporter>(settings.inputFile);
+}
+
+SyntheticScene::SyntheticScene(const SyntheticSceneOptions& options)
+	: format(CreateSettingsFormat()), random(options.seed)
+{
+	std::vector<Vector3> positions;
+
+	// Cornell box, open towards the camera
+	AddQuad(positions, Vector3(-5, 0, 5), Vector3(5, 0, 5), Vector3(5, 0, -5), Vector3(-5, 0, -5));
+
+	if(options.variant != "open")
+	{
+		AddQuad(positions, Vector3(-5, 10, -5), Vector3(5, 10, -5), Vector3(5, 10, 5), Vector3(-5, 10, 5));
+		AddQuad(positions, Vector3(-5, 0, -5), Vector3(5, 0, -5), Vector3(5, 10, -5), Vector3(-5, 10, -5));
+	}
+
+	AddMesh(positions, CreateDiffuseMaterial("White", Pixel(0.75f, 0.75f, 0.75f)));
+
+	if(options.variant != "open")
+	{
+		positions.clear();
+		AddQuad(positions, Vector3(-5, 0, 5), Vector3(-5, 0, -5), Vector3(-5, 10, -5), Vector3(-5, 10, 5));
+		AddMesh(positions, CreateDiffuseMaterial("Red", Pixel(0.75f, 0.25f, 0.25f)));
+
+		positions.clear();
+		AddQuad(positions, Vector3(5, 0, -5), Vector3(5, 0, 5), Vector3(5, 10, 5), Vector3(5, 10, -5));
+		AddMesh(positions, CreateDiffuseMaterial("Green", Pixel(0.25f, 0.75f, 0.25f)));
+	}
+
+	// area light, facing downwards
+	positions.clear();
+	AddQuad(positions, Vector3(-1.5f, 9.99f, -1.5f), Vector3(1.5f, 9.99f, -1.5f), Vector3(1.5f, 9.99f, 1.5f), Vector3(-1.5f, 9.99f, 1.5f));
+	AddMesh(positions, CreateEmissiveMaterial("Light", 1));
+
+	// one diffuse and one glass block
+	if(options.variant == "cornell")
+	{
+		positions.clear();
+		AddBox(positions, Vector3(-3.5f, 0, -3.5f), Vector3(-0.5f, 6, -0.5f));
+		AddMesh(positions, CreateDiffuseMaterial("Block", Pixel(0.75f, 0.75f, 0.75f)));
+
+		positions.clear();
+		AddBox(positions, Vector3(0.5f, 0, 0.5f), Vector3(3.5f, 3, 3.5f));
+		AddMesh(positions, CreateGlassMaterial("Glass", 1.5f));
+	}
+
+	AddEmissiveMeshes(options);
+	AddGlassLayers(options);
+
+	// clutter to scale the triangle count
+	if(options.clutterTriangles > 0)
+	{
+		positions.clear();
+		positions.reserve(options.clutterTriangles * 3);
+
+		for(int i = 0; i < options.clutterTriangles; i++)
+		{
+			Vector3 center(
+				-4.5f + 9 * random.NextFloat(), 
+				0.5f + 8.5f * random.NextFloat(), 
+				-4.5f + 9 * random.NextFloat());
+			float size = 0.05f + 0.25f * random.NextFloat();
+
+			for(int j = 0; j < 3; j++)
+				positions.push_back(center + size * Math::GetRandomVectorInUnitCube(random));
+		}
+
+		AddMesh(positions, CreateDiffuseMaterial("Clutter", Pixel(0.5f, 0.5f, 0.75f)));
+	}
+
+	// instances come last, so they can fill up the triangle budget
+	AddInstances(options, GetTriangleCount());
+
+	cameras.push_back(Camera(
+		"Synthetic", 
+		1, 
+		Matrix4x4::lookAt(Vectormath::Aos::Point3(0, 5, 15.5f), Vectormath::Aos::Point3(0, 5, 0), Vectormath::Aos::Vector3(0, 1, 0)),
+		Matrix4x4::perspective(40 * Math::PI / 180, 1, 0.1f, 100)));
+
+	CollectLights();
+}
+
+std::shared_ptr<UnifiedSettings> SyntheticScene::CreateDiffuseMaterial(std::string name, Pixel color)
+{
+	auto material = format->GetChild("Material")->Clone();
+
+	material->SetString("Name", name);
+	material->AddChildInstance("Surface")->AddChildInstance("Diffuse")->SetColor("Color", color);
+	material->AddChildInstance("Lighting")->AddChildInstance("Lambert");
+
+	return material;
+}
+
+std::shared_ptr<UnifiedSettings> SyntheticScene::CreateEmissiveMaterial(std::string name, float intensity)
+{
+	auto material = CreateDiffuseMaterial(name, Pixel(1, 1, 1));
+	auto photon = material->TryGetInstancePath("Surface", "Diffuse")->AddChildInstance("Photon");
+
+	photon->SetSingle("PhotonIntensity", intensity);
+	material->TryGetInstancePath("Lighting", "Lambert")->SetSingle("EmissiveIntensity", intensity);
+
+	return material;
+}
+
+std::shared_ptr<UnifiedSettings> SyntheticScene::CreateGlassMaterial(std::string name, float refractiveIndex)
+{
+	auto material = format->GetChild("Material")->Clone();
+	auto caustic = material->AddChildInstance("Caustic");
+
+	material->SetString("Name", name);
+	caustic->SetBoolean("EnableCaustics", true);
+
+	for(auto kind : { "Reflection", "Refraction" })
+	{
+		auto fresnel = caustic->AddChildInstance(kind)->AddChildInstance("Visibility")->AddChildInstance("Fresnel");
+		fresnel->SetVector3("RealRefractiveIndex", Vector3(refractiveIndex, refractiveIndex, refractiveIndex));
+	}
+
+	return material;
+}
+
+std::shared_ptr<Mesh> SyntheticScene::AddMesh(const std::vector<Vector3>& positions, std::shared_ptr<UnifiedSettings> material)
+{
+	auto mesh = std::make_shared<Mesh>();
+	const int triangleCount = (int)positions.size() / 3;
+
+	mesh->vertices.reserve(triangleCount * 3);
+
+	for(int i = 0; i < triangleCount * 3; i += 3)
+	{
+		Vector3 normal = Math::Normalized(Math::Cross(positions[i + 1] - positions[i], positions[i + 2] - positions[i]));
+
+		for(int j = 0; j < 3; j++)
+		{
+			Vertex v;
+
+			v.position = positions[i + j];
+			v.normal = normal;
+			v.matUv = Vector3((j == 1) ? 1.0f : 0.0f, (j == 2) ? 1.0f : 0.0f, 0);
+
+			mesh->vertices.push_back(v);
+		}
+	}
+
+	mesh->triangles.reserve(triangleCount);
+	for(int i = 0, j = 0; i < triangleCount; i++, j += 3)
+	{
+		mesh->triangles.push_back(Triangle(mesh.get(), j, j + 1, j + 2));
+	}
+
+	mesh->material = BSDFMaterial::FromTemplate(material);
+	mesh->light = LightSource::TryFromTemplate(material, mesh);
+
+	meshes.push_back(mesh);
+
+	return mesh;
+}
+
+void SyntheticScene::AddQuad(std::vector<Vector3>& positions, Vector3 a, Vector3 b, Vector3 c, Vector3 d)
+{
+	positions.push_back(a); positions.push_back(b); positions.push_back(c);
+	positions.push_back(a); positions.push_back(c); positions.push_back(d);
+}
+
+void SyntheticScene::AddBox(std::vector<Vector3>& positions, Vector3 min, Vector3 max)
+{
+	const float x0 = min.x, y0 = min.y, z0 = min.z, x1 = max.x, y1 = max.y, z1 = max.z;
+
+	// all faces point outwards
+	AddQuad(positions, Vector3(x0, y0, z0), Vector3(x1, y0, z0), Vector3(x1, y0, z1), Vector3(x0, y0, z1));
+	AddQuad(positions, Vector3(x0, y1, z1), Vector3(x1, y1, z1), Vector3(x1, y1, z0), Vector3(x0, y1, z0));
+	AddQuad(positions, Vector3(x0, y0, z1), Vector3(x1, y0, z1), Vector3(x1, y1, z1), Vector3(x0, y1, z1));
+	AddQuad(positions, Vector3(x1, y0, z0), Vector3(x0, y0, z0), Vector3(x0, y1, z0), Vector3(x1, y1, z0));
+	AddQuad(positions, Vector3(x0, y0, z0), Vector3(x0, y0, z1), Vector3(x0, y1, z1), Vector3(x0, y1, z0));
+	AddQuad(positions, Vector3(x1, y0, z1), Vector3(x1, y0, z0), Vector3(x1, y1, z0), Vector3(x1, y1, z1));
+}
+
+std::shared_ptr<Mesh> SyntheticScene::CreateSphere(int triangleCount)
+{
+	// a UV-sphere with "2 * rings" segments has "4 * rings * (rings - 1)" triangles
+	const int rings = std::max(3, (int)std::ceil((1 + std::sqrt(1.0 + triangleCount)) / 2));
+	const int segments = 2 * rings;
+	auto mesh = std::make_shared<Mesh>();
+
+	auto getPoint = [&](int ring, int segment) -> Vector3
+	{
+		float theta = Math::PI * ring / rings, phi = 2 * Math::PI * segment / segments;
+		return Vector3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+	};
+
+	// neighbouring triangles share the vertices of the ring/segment grid, the last segment wraps around
+	auto getIndex = [&](int ring, int segment) { return ring * segments + segment % segments; };
+
+	mesh->vertices.reserve((rings + 1) * segments);
+
+	for(int ring = 0; ring <= rings; ring++)
+	{
+		for(int segment = 0; segment < segments; segment++)
+		{
+			Vertex v;
+
+			v.position = getPoint(ring, segment);
+			v.normal = v.position;
+			v.matUv = Vector3(0, 0, 0);
+
+			mesh->vertices.push_back(v);
+		}
+	}
+
+	mesh->triangles.reserve(segments * (rings - 1) * 2);
+
+	for(int ring = 0; ring < rings; ring++)
+	{
+		for(int segment = 0; segment < segments; segment++)
+		{
+			int a = getIndex(ring, segment), b = getIndex(ring, segment + 1);
+			int c = getIndex(ring + 1, segment), d = getIndex(ring + 1, segment + 1);
+
+			// the poles degenerate to a single triangle per segment
+			if(ring > 0) mesh->triangles.push_back(Triangle(mesh.get(), a, b, d));
+			if(ring < rings - 1) mesh->triangles.push_back(Triangle(mesh.get(), a, d, c));
+		}
+	}
+
+	return mesh;
+}
+
+void SyntheticScene::AddInstances(const SyntheticSceneOptions& options, int fixedTriangles)
+{
+	const int instances = ((options.instances == 0) && (options.triangles > fixedTriangles)) ? 1 : options.instances;
+
+	if(instances == 0)
+		return;
+
+	const int perInstance = std::max(48, (options.triangles - fixedTriangles) / instances);
+	const int grid = (int)std::ceil(std::pow((double)instances, 1.0 / 3) - 1e-6);
+	const float cell = 9.0f / grid, height = 8.5f / grid;
+	auto sphere = CreateSphere(perInstance);
+	auto material = CreateDiffuseMaterial("Instance", Pixel(0.75f, 0.6f, 0.3f));
+
+	for(int i = 0; i < instances; i++)
+	{
+		const int x = i % grid, y = (i / grid) / grid, z = (i / grid) % grid;
+		const float radius = 0.4f * std::min(cell, height);
+		Vector3 center(-4.5f + (x + 0.5f) * cell, 0.25f + (y + 0.5f) * height, -4.5f + (z + 0.5f) * cell);
+
+		// random orientation, otherwise all instances share the same tessellation pattern
+		Matrix4x4 transform = 
+			Matrix4x4::translation(Math::Convert(center)) * 
+			Matrix4x4::rotationY(2 * Math::PI * random.NextFloat()) * 
+			Matrix4x4::scale(Vectormath::Aos::Vector3(radius, radius, radius));
+
+		meshes.push_back(sphere->Instanciate(transform, material));
+	}
+}
+
+void SyntheticScene::AddEmissiveMeshes(const SyntheticSceneOptions& options)
+{
+	if(options.emissiveMeshes == 0)
+		return;
+
+	auto sphere = CreateSphere(48);
+	auto material = CreateEmissiveMaterial("EmissiveSphere", 1.0f / options.emissiveMeshes);
+
+	for(int i = 0; i < options.emissiveMeshes; i++)
+	{
+		Vector3 center(-4.5f + 9 * random.NextFloat(), 8.5f + random.NextFloat(), -4.5f + 9 * random.NextFloat());
+
+		meshes.push_back(sphere->Instanciate(
+			Matrix4x4::translation(Math::Convert(center)) * Matrix4x4::scale(Vectormath::Aos::Vector3(0.2f, 0.2f, 0.2f)), 
+			material));
+	}
+}
+
+void SyntheticScene::AddGlassLayers(const SyntheticSceneOptions& options)
+{
+	auto material = CreateGlassMaterial("GlassLayer", 1.5f);
+
+	// panes stacked along the view direction, in front of everything else
+	for(int i = 0; i < options.glassLayers; i++)
+	{
+		std::vector<Vector3> positions;
+		float z = 4.8f - i * std::min(0.3f, 3.0f / options.glassLayers);
+
+		AddBox(positions, Vector3(-4.9f, 0.01f, z - 0.05f), Vector3(4.9f, 9.9f, z));
+		AddMesh(positions, material);
+	}
+}
+
+void SyntheticScene::CollectLights()
+{
+	int iLight = 0;
+	for(const auto& mesh : meshes)
+	{
+		if(mesh->GetLight())
+		{
+			auto light = mesh->GetLight();
+			light->SetIndex(iLight++);
+			lights.push_back(light);
+		}
+	}
+}
+
+int SyntheticScene::GetTriangleCount() const
+{
+	int count = 0;
+	for(const auto& mesh : meshes)
+		count += (int)mesh->triangles.size();
+	return count;
+}
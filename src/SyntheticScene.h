@@ -0,0 +1,85 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef _SYNTHETICSCENE_H_
+#define _SYNTHETICSCENE_H_
+
+struct SyntheticSceneOptions
+{
+	/** "cornell" (box with a diffuse and a glass block), "empty" (box only) or "open" (floor only). */
+	std::string variant;
+	/** Number of randomly placed small diffuse triangles added to the Cornell box. */
+	int clutterTriangles;
+	/** Number of instances of one tessellated sphere, placed on a grid inside the box. */
+	int instances;
+	/** Target for the total triangle count, the difference is spread over the instances. */
+	int triangles;
+	/** Number of small emissive spheres under the ceiling, in addition to the area light. */
+	int emissiveMeshes;
+	/** Number of glass panes stacked between the camera and the rest of the scene. */
+	int glassLayers;
+	/** Seed for everything random in the scene, equal seeds produce equal scenes. */
+	uint32_t seed;
+
+	SyntheticSceneOptions() : variant("cornell"), clutterTriangles(0), instances(0), triangles(0), emissiveMeshes(0), glassLayers(0), seed(0) { }
+
+	/*
+		Parses a comma separated list like "cornell,instances=64,triangles=1000000,glass=2".
+		The optional first entry without a value is the variant, valid keys are "variant",
+		"clutter", "instances", "triangles", "emissive", "glass" and "seed".
+	*/
+	static SyntheticSceneOptions Parse(std::string spec);
+};
+
+/*
+	A scene built in code instead of being loaded from a Unity export: a Cornell box with
+	an area light under the ceiling, a diffuse block and a glass block. It is meant for
+	benchmarks and for reproducing performance issues without shipping scene files around.
+	Materials are instantiated from CreateSettingsFormat(), exactly like imported ones.
+*/
+class SyntheticScene : public Scene
+{
+private:
+	std::shared_ptr<UnifiedSettings> format;
+	RandomGenerator random;
+
+	std::shared_ptr<UnifiedSettings> CreateDiffuseMaterial(std::string name, Pixel color);
+	std::shared_ptr<UnifiedSettings> CreateEmissiveMaterial(std::string name, float intensity);
+	std::shared_ptr<UnifiedSettings> CreateGlassMaterial(std::string name, float refractiveIndex);
+
+	/** Creates a mesh from a triangle soup, three consecutive positions form one counter-clockwise triangle. */
+	std::shared_ptr<Mesh> AddMesh(const std::vector<Vector3>& positions, std::shared_ptr<UnifiedSettings> material);
+
+	static void AddQuad(std::vector<Vector3>& positions, Vector3 a, Vector3 b, Vector3 c, Vector3 d);
+	static void AddBox(std::vector<Vector3>& positions, Vector3 min, Vector3 max);
+
+	/** Unit sphere at the origin with smooth normals, roughly "triangleCount" triangles. Not part of the scene. */
+	static std::shared_ptr<Mesh> CreateSphere(int triangleCount);
+
+	void AddInstances(const SyntheticSceneOptions& options, int fixedTriangles);
+	void AddEmissiveMeshes(const SyntheticSceneOptions& options);
+	void AddGlassLayers(const SyntheticSceneOptions& options);
+
+	void CollectLights();
+
+public:
+	SyntheticScene(const SyntheticSceneOptions& options);
+
+	int GetTriangleCount() const;
+};
+
+#endif
@@ -0,0 +1,207 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+#include "stdafx.h"
+
+TaskPool::TaskPool(int threadCount) : queuedCount(0), sleepingCount(0), nextExternal(0), terminate(false)
+{
+	threadCount = std::max(1, threadCount);
+
+	for(int i = 0; i < threadCount; i++)
+		workers.emplace_back(std::make_unique<Worker>());
+
+	// start threads only after all deques exist, since workers steal from each other
+	for(int i = 0; i < threadCount; i++)
+		workers[i]->thread = std::thread([this, i]() { Run(i); });
+}
+
+TaskPool::~TaskPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		terminate = true;
+	}
+	wakeUp.notify_all();
+
+	for(auto& worker : workers)
+		worker->thread.join();
+}
+
+void TaskPool::Submit(TaskGroup& group, Task task, int workerIndex)
+{
+	if((workerIndex < 0) || (workerIndex >= GetThreadCount()))
+		workerIndex = (int)(nextExternal++ % workers.size());
+
+	group.pending++;
+
+	{
+		Worker& worker = *workers[workerIndex];
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.tasks.emplace_back(&group, std::move(task));
+	}
+
+	queuedCount++;
+
+	// sleeping workers check "queuedCount" under the lock, so no wakeup can get lost here
+	if(sleepingCount > 0)
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		wakeUp.notify_one();
+	}
+}
+
+bool TaskPool::TryPop(int workerIndex, std::pair<TaskGroup*, Task>& outTask)
+{
+	const int count = GetThreadCount();
+
+	if(queuedCount == 0)
+		return false;
+
+	// own deque first (newest task), then steal oldest tasks from the others
+	for(int i = 0; i < count; i++)
+	{
+		Worker& victim = *workers[(workerIndex + i) % count];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+
+		if(victim.tasks.empty())
+			continue;
+
+		if(i == 0)
+		{
+			outTask = std::move(victim.tasks.back());
+			victim.tasks.pop_back();
+		}
+		else
+		{
+			outTask = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+		}
+
+		queuedCount--;
+		return true;
+	}
+
+	return false;
+}
+
+void TaskPool::Execute(int workerIndex, std::pair<TaskGroup*, Task>& task)
+{
+	TaskGroup& group = *task.first;
+
+	try
+	{
+		task.second(workerIndex);
+	}
+	catch(...)
+	{
+		std::lock_guard<std::mutex> lock(group.mutex);
+		if(!group.error)
+			group.error = std::current_exception();
+	}
+
+	task.second = nullptr;
+
+	// the group must not be touched after the lock is released, its owner may be gone already
+	std::lock_guard<std::mutex> lock(group.mutex);
+	if(--group.pending == 0)
+		group.done.notify_all();
+}
+
+void TaskPool::Run(int workerIndex)
+{
+	std::pair<TaskGroup*, Task> task;
+
+	while(true)
+	{
+		if(TryPop(workerIndex, task))
+		{
+			Execute(workerIndex, task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+
+		sleepingCount++;
+		wakeUp.wait(lock, [&]() { return (queuedCount > 0) || terminate; });
+		sleepingCount--;
+
+		if(terminate)
+			break;
+	}
+}
+
+void TaskPool::Wait(TaskGroup& group, int workerIndex)
+{
+	if((workerIndex >= 0) && (workerIndex < GetThreadCount()))
+	{
+		// help out instead of blocking a worker
+		std::pair<TaskGroup*, Task> task;
+
+		while(!group.IsDone())
+		{
+			if(TryPop(workerIndex, task))
+				Execute(workerIndex, task);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+	// also synchronizes with the last Execute() still holding the lock
+	std::unique_lock<std::mutex> lock(group.mutex);
+	group.done.wait(lock, [&]() { return group.IsDone(); });
+
+	if(group.error)
+	{
+		std::exception_ptr error = group.error;
+		group.error = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+void TaskPool::SplitRange(TaskGroup& group, int workerIndex, int begin, int end, int grainSize, const RangeTask& task)
+{
+	// keep the lower half and offer the upper half to thieves
+	while(end - begin > grainSize)
+	{
+		int middle = begin + (end - begin) / 2;
+
+		Submit(group, [this, &group, &task, middle, end, grainSize](int worker)
+		{
+			SplitRange(group, worker, middle, end, grainSize, task);
+		}, workerIndex);
+
+		end = middle;
+	}
+
+	task(workerIndex, begin, end);
+}
+
+void TaskPool::ParallelFor(int begin, int end, int grainSize, const RangeTask& task, int workerIndex)
+{
+	TaskGroup group;
+
+	if(begin >= end)
+		return;
+
+	grainSize = std::max(1, grainSize);
+
+	Submit(group, [this, &group, &task, begin, end, grainSize](int worker)
+	{
+		SplitRange(group, worker, begin, end, grainSize, task);
+	}, workerIndex);
+
+	Wait(group, workerIndex);
+}
@@ -0,0 +1,113 @@
+// ======================================================================== //
+// Copyright 2013 Christoph Husse                                           //
+//                                                                          //
+// Licensed under the Apache License, Version 2.0 (the "License");          //
+// you may not use this file except in compliance with the License.         //
+// You may obtain a copy of the License at                                  //
+//                                                                          //
+//     http://www.apache.org/licenses/LICENSE-2.0                           //
+//                                                                          //
+// Unless required by applicable law or agreed to in writing, software      //
+// distributed under the License is distributed on an "AS IS" BASIS,        //
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. //
+// See the License for the specific language governing permissions and      //
+// limitations under the License.                                           //
+// ======================================================================== //
+
+
+#ifndef _TASKPOOL_H_
+#define _TASKPOOL_H_
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <exception>
+
+/*
+	Tracks completion of a set of tasks submitted to a TaskPool. The first exception
+	thrown by any task of the group is rethrown by TaskPool::Wait().
+*/
+class TaskGroup : boost::noncopyable
+{
+private:
+	friend class TaskPool;
+
+	std::atomic<int> pending;
+	std::mutex mutex;
+	std::condition_variable done;
+	std::exception_ptr error;
+
+public:
+	TaskGroup() : pending(0) { }
+
+	bool IsDone() const { return pending == 0; }
+};
+
+/*
+	Persistent pool of worker threads with one task deque per worker. A worker pushes
+	and pops its own tasks at the back (depth first, cache friendly), idle workers steal
+	from the front of other deques (oldest and usually biggest chunks of work).
+
+	Every task receives the index of the worker executing it, which is in [0, GetThreadCount())
+	and can be used to address per-thread state like a ThreadContext. A task that waits for
+	a nested group may execute other tasks of the same worker in the meantime, so per-thread
+	state must not be kept across such a Wait().
+*/
+class TaskPool : boost::noncopyable
+{
+public:
+	typedef std::function<void (int workerIndex)> Task;
+	typedef std::function<void (int workerIndex, int begin, int end)> RangeTask;
+
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<std::pair<TaskGroup*, Task>> tasks;
+		std::thread thread;
+	};
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::mutex sleepMutex;
+	std::condition_variable wakeUp;
+	std::atomic<int> queuedCount;
+	std::atomic<int> sleepingCount;
+	std::atomic<unsigned> nextExternal;
+	std::atomic<bool> terminate;
+
+	bool TryPop(int workerIndex, std::pair<TaskGroup*, Task>& outTask);
+	void Execute(int workerIndex, std::pair<TaskGroup*, Task>& task);
+	void Run(int workerIndex);
+	void SplitRange(TaskGroup& group, int workerIndex, int begin, int end, int grainSize, const RangeTask& task);
+
+public:
+	explicit TaskPool(int threadCount);
+	~TaskPool();
+
+	int GetThreadCount() const { return (int)workers.size(); }
+
+	/*
+		Queues "task" as part of "group". Pass the index of the calling worker (if any) as
+		"workerIndex", so the task ends up in the local deque. Submissions from outside
+		of the pool are distributed round robin.
+	*/
+	void Submit(TaskGroup& group, Task task, int workerIndex = -1);
+
+	/*
+		Blocks until all tasks of "group" have finished. Workers keep executing tasks while
+		waiting, so this can also be called from within a task.
+	*/
+	void Wait(TaskGroup& group, int workerIndex = -1);
+
+	/*
+		Invokes "task" for disjoint subranges of [begin, end) with at most "grainSize" elements
+		and returns when all of them are done. The range is split recursively, so idle workers
+		steal large chunks first and load balancing adapts to very uneven costs per element.
+	*/
+	void ParallelFor(int begin, int end, int grainSize, const RangeTask& task, int workerIndex = -1);
+};
+
+#endif
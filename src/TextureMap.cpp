@@ -20,6 +20,9 @@
 
 #include <ImfRgbaFile.h>
 #include <ImfArray.h>
+#include <ImfOutputFile.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
 
 
 TextureMap::TextureMap(int width, int height, int channelCount) : UVMapNPOT<Texel>(width, height), channelCount(channelCount)
@@ -78,6 +81,33 @@ void RenderBuffer::SaveToEXR(std::string fileName)
 	file.writePixels(GetHeight());
 }
 
+void ChannelBuffer::SaveToEXR(std::string fileName, const std::vector<std::pair<std::string, const ChannelBuffer*>>& channels)
+{
+	if(channels.empty())
+		return;
+
+	const int width = channels.front().second->GetWidth(), height = channels.front().second->GetHeight();
+	Imf::Header header(width, height);
+	Imf::FrameBuffer frameBuffer;
+
+	for(const auto& channel : channels)
+	{
+		if((channel.second->GetWidth() != width) || (channel.second->GetHeight() != height))
+			throw std::invalid_argument("All channels of an EXR file must have the same dimensions.");
+
+		header.channels().insert(channel.first, Imf::Channel(Imf::FLOAT));
+		frameBuffer.insert(channel.first, Imf::Slice(
+			Imf::FLOAT, 
+			(char*)channel.second->entries.data(), 
+			sizeof(float), 
+			sizeof(float) * width));
+	}
+
+	Imf::OutputFile file(fileName.c_str(), header);
+	file.setFrameBuffer(frameBuffer);
+	file.writePixels(height);
+}
+
 void RenderBuffer::BlitToOpenGL(Rect rect) const
 {
 	std::vector<unsigned char> pixels(rect.width * rect.height * 3);
@@ -114,9 +144,13 @@ float TextureMap::ExtractHeight(const Texel& pixel) const
 }
 
 Pixel TextureMap::Interpolated(const Triangle& triangle, Vector3 w) const
+{
+	return Interpolated(MakeUV(triangle, w));
+}
+
+Pixel TextureMap::Interpolated(Vector3 uv) const
 {
 	const TextureMap& tex = *this;
-	Vector3 uv = MakeUV(triangle, w);
 
 	// bilinear filtering (Wikipedia)
 	float u = uv.x * GetWidth() - 0.5;
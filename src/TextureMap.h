@@ -35,6 +35,7 @@ public:
 	float ExtractAlpha(const Texel& pixel) const;
 	float ExtractHeight(const Texel& pixel) const;
 	Pixel Interpolated(const Triangle& triangle, Vector3 w) const;
+	Pixel Interpolated(Vector3 uv) const;
 };
 
 class RenderBuffer : public UVMapNPOT<Pixel>
@@ -46,4 +47,17 @@ public:
 	void BlitToOpenGL(Rect rect) const;
 };
 
+/*
+	A single raw float channel, like per-pixel timings or work counts. Several of them
+	are saved as named layers of one EXR file, without any normalization.
+*/
+class ChannelBuffer : public UVMapNPOT<float>
+{
+public:
+	ChannelBuffer(int width, int height) : UVMapNPOT<float>(width, height) { }
+
+	/** All channels need to have the same dimensions. */
+	static void SaveToEXR(std::string fileName, const std::vector<std::pair<std::string, const ChannelBuffer*>>& channels);
+};
+
 #endif
\ No newline at end of file
@@ -77,13 +77,212 @@ const RenderSettings& ThreadContext::GetSettings() const { return rayTracer->set
 PhotonMap& ThreadContext::GetIndirectMap() { return rayTracer->GetIndirectMap(); }
 PhotonMap& ThreadContext::GetDirectMap() { return rayTracer->GetDirectMap(); }
 PhotonMap& ThreadContext::GetCausticsMap() { return rayTracer->GetCausticsMap(); }
-bool ThreadContext::CastRay(const PathSegment& incoming, PathSegment& outgoing) { return intersector->CastRay(*this, incoming, outgoing); }
 Pixel ThreadContext::GetClearColor() const { return rayTracer->GetClearColor(); }
 
+bool ThreadContext::CastRay(const PathSegment& incoming, PathSegment& outgoing, int rayKind) 
+{ 
+	bool hasHit = intersector->CastRay(*this, incoming, outgoing);
+
+	stats.rays[rayKind]++;
+	(hasHit ? stats.rayHits : stats.rayMisses)++;
+
+	return hasHit;
+}
+
+int ThreadContext::CastRays(PathSegment* segments, int count, int rayKind)
+{
+	int hitCount = intersector->CastRays(*this, segments, count);
+
+	stats.rays[rayKind] += count;
+	stats.rayHits += hitCount;
+	stats.rayMisses += count - hitCount;
+
+	return hitCount;
+}
+
+int ThreadContext::CastRayStream(PathSegment* segments, int count, int rayKind)
+{
+	if(count == 0)
+		return 0;
+
+	// origins are quantized to 10 bits per axis within the bounds of the stream
+	Vector3 lower = segments[0].GetOrigin(), upper = lower;
+
+	for(int i = 1; i < count; i++)
+	{
+		lower = Math::MinPerElem(lower, segments[i].GetOrigin());
+		upper = Math::MaxPerElem(upper, segments[i].GetOrigin());
+	}
+
+	const Vector3 extent = upper - lower;
+	const float scale[3] = { 
+		(extent.x > 0) ? 1023 / extent.x : 0, 
+		(extent.y > 0) ? 1023 / extent.y : 0, 
+		(extent.z > 0) ? 1023 / extent.z : 0 };
+
+	rayStreamOrder.clear();
+
+	for(int i = 0; i < count; i++)
+	{
+		const Vector3 origin = segments[i].GetOrigin() - lower;
+		const Vector3 direction = segments[i].GetDirection();
+		const uint64_t octant = (direction.x < 0 ? 1 : 0) | (direction.y < 0 ? 2 : 0) | (direction.z < 0 ? 4 : 0);
+		const uint32_t morton = Math::MortonCode((uint32_t)(origin.x * scale[0]), (uint32_t)(origin.y * scale[1]), (uint32_t)(origin.z * scale[2]));
+
+		rayStreamOrder.push_back(std::make_pair((octant << 30) | morton, i));
+	}
+
+	std::sort(rayStreamOrder.begin(), rayStreamOrder.end());
+
+	rayStreamBuffer.clear();
+
+	for(const auto& entry : rayStreamOrder)
+	{
+		rayStreamBuffer.push_back(segments[entry.second]);
+	}
+
+	int hitCount = CastRays(rayStreamBuffer.data(), count, rayKind);
+
+	for(int i = 0; i < count; i++)
+	{
+		segments[rayStreamOrder[i].second] = rayStreamBuffer[i];
+	}
+
+	return hitCount;
+}
+
+bool ThreadContext::IsSegmentVisible(Vector3 from, const Triangle* fromTriangle, Vector3 to, int rayKind, float tolerance)
+{
+	const float distance = Math::Length(to - from);
+
+	// the segment must not hit the triangle it starts on, the one at "to" is unknown and cut off instead
+	const float epsilon = 1e-4f * distance;
+	bool isOccluded = (distance - tolerance > epsilon) && 
+		intersector->IsOccluded(from, (to - from) / distance, 0, distance - std::max(epsilon, tolerance), fromTriangle ? fromTriangle->GetFaceIndex() : -1);
+
+	stats.rays[rayKind]++;
+	(isOccluded ? stats.rayHits : stats.rayMisses)++;
+
+	return !isOccluded;
+}
+
+void ThreadContext::SamplePhotons(PhotonMap& map, Vector3 where, int sampleCount)
+{
+	map.Sample(where, sampleCount, samples);
+
+	stats.photonQueries++;
+	stats.photonsVisited += samples.GetVisitedCount();
+}
+
+void ThreadContext::SamplePhotons(PhotonMap& map, const Vector3* where, int count, int sampleCount)
+{
+	while(batchSamples.size() < (size_t)count) batchSamples.emplace_back();
+
+	if(count == 0)
+		return;
+
+	// points are quantized to 10 bits per axis within the bounds of the batch, as in CastRayStream()
+	Vector3 lower = where[0], upper = lower;
+
+	for(int i = 1; i < count; i++)
+	{
+		lower = Math::MinPerElem(lower, where[i]);
+		upper = Math::MaxPerElem(upper, where[i]);
+	}
+
+	const Vector3 extent = upper - lower;
+	const float scale[3] = { 
+		(extent.x > 0) ? 1023 / extent.x : 0, 
+		(extent.y > 0) ? 1023 / extent.y : 0, 
+		(extent.z > 0) ? 1023 / extent.z : 0 };
+
+	photonQueryOrder.clear();
+
+	for(int i = 0; i < count; i++)
+	{
+		const Vector3 point = where[i] - lower;
+
+		photonQueryOrder.push_back(std::make_pair(Math::MortonCode((uint32_t)(point.x * scale[0]), (uint32_t)(point.y * scale[1]), (uint32_t)(point.z * scale[2])), i));
+	}
+
+	std::sort(photonQueryOrder.begin(), photonQueryOrder.end());
+
+	photonQueryPoints.clear();
+	photonQueryResults.clear();
+
+	for(const auto& entry : photonQueryOrder)
+	{
+		photonQueryPoints.push_back(where[entry.second]);
+		photonQueryResults.push_back(&batchSamples[entry.second]);
+	}
+
+	map.SampleBatch(photonQueryPoints.data(), photonQueryResults.data(), count, sampleCount);
+
+	stats.photonQueries += count;
+
+	for(int i = 0; i < count; i++)
+	{
+		stats.photonsVisited += batchSamples[i].GetVisitedCount();
+	}
+}
+
+void ThreadStats::Reset()
+{
+	std::fill(rays, rays + ERayKind::Count, 0);
+	std::fill(bsdfEvaluations, bsdfEvaluations + EBsdfEvaluation::Count, 0);
+
+	rayHits = rayMisses = 0;
+	photonQueries = photonsVisited = 0;
+	pixels = directPasses = indirectPasses = 0;
+	transmissiveWalks = transmissiveLayers = 0;
+}
+
+ThreadStats& ThreadStats::operator+=(const ThreadStats& rhs)
+{
+	for(int i = 0; i < ERayKind::Count; i++) rays[i] += rhs.rays[i];
+	for(int i = 0; i < EBsdfEvaluation::Count; i++) bsdfEvaluations[i] += rhs.bsdfEvaluations[i];
+
+	rayHits += rhs.rayHits;
+	rayMisses += rhs.rayMisses;
+	photonQueries += rhs.photonQueries;
+	photonsVisited += rhs.photonsVisited;
+	pixels += rhs.pixels;
+	directPasses += rhs.directPasses;
+	indirectPasses += rhs.indirectPasses;
+	transmissiveWalks += rhs.transmissiveWalks;
+	transmissiveLayers += rhs.transmissiveLayers;
+
+	return *this;
+}
+
+void ThreadStats::WriteJSON(std::ostream& out, std::string indent) const
+{
+	auto ratio = [](int64_t a, int64_t b) { return (b > 0) ? a / (double)b : 0.0; };
+
+	out << "{" << std::endl;
+	out << indent << "  \"rays\": { \"primary\": " << rays[ERayKind::Primary] << ", \"shadow\": " << rays[ERayKind::Shadow] 
+		<< ", \"indirect\": " << rays[ERayKind::Indirect] << ", \"photon\": " << rays[ERayKind::Photon] 
+		<< ", \"hits\": " << rayHits << ", \"misses\": " << rayMisses << " }," << std::endl;
+	out << indent << "  \"knn\": { \"queries\": " << photonQueries << ", \"photons_visited\": " << photonsVisited 
+		<< ", \"visited_per_query\": " << ratio(photonsVisited, photonQueries) << " }," << std::endl;
+	out << indent << "  \"bsdf_evaluations\": { \"surface\": " << bsdfEvaluations[EBsdfEvaluation::Surface] 
+		<< ", \"direct_illumination\": " << bsdfEvaluations[EBsdfEvaluation::DirectIllumination]
+		<< ", \"local_illumination\": " << bsdfEvaluations[EBsdfEvaluation::LocalIllumination]
+		<< ", \"transmit_photon\": " << bsdfEvaluations[EBsdfEvaluation::TransmitPhoton]
+		<< ", \"transmit_camera\": " << bsdfEvaluations[EBsdfEvaluation::TransmitCamera] << " }," << std::endl;
+	out << indent << "  \"pixels\": { \"count\": " << pixels 
+		<< ", \"direct_passes_per_pixel\": " << ratio(directPasses, pixels) 
+		<< ", \"indirect_passes_per_pixel\": " << ratio(indirectPasses, pixels) << " }," << std::endl;
+	out << indent << "  \"transmissive\": { \"walks\": " << transmissiveWalks << ", \"layers\": " << transmissiveLayers 
+		<< ", \"layers_per_walk\": " << ratio(transmissiveLayers, transmissiveWalks) << " }" << std::endl;
+	out << indent << "}";
+}
 ThreadContext::ThreadContext(RayTracer* tracer, int threadIndex) 
 		: 
 		rayTracer(tracer), 
 		intersector(),
+		random(threadIndex),
+		sampler(Sampler::Create(tracer->GetSettings().sampler)),
 		threadIndex(threadIndex)
 { 
 }
@@ -113,10 +312,12 @@ bool ThreadContext::FollowTransmissive(PathSegment& view, Pixel* addToColor, BSD
 	throw std::bad_exception("This should never happen!");
 }
 
-ETransmissionResult ThreadContext::FollowTransmissiveEx(PathSegment& line, BSDF** outBsdf, bool onStraightLine)
+ETransmissionResult ThreadContext::FollowTransmissiveEx(PathSegment& line, BSDF** outBsdf, bool onStraightLine, int rayKind)
 {
 	const PathSegment originalLine = line;
 
+	stats.transmissiveWalks++;
+
 	if(outBsdf != nullptr)
 		*outBsdf = nullptr;
 
@@ -124,18 +325,22 @@ ETransmissionResult ThreadContext::FollowTransmissiveEx(PathSegment& line, BSDF*
 
 	while(true)
 	{
+		stats.transmissiveLayers++;
+
 		if(!line.CanBounceAgain())
 			return ETransmissionResult::NotAlive; 
 
-		if(!line.HasImpact() && !CastRay(line, line))
+		if(!line.HasImpact() && !CastRay(line, line, rayKind))
 			return ETransmissionResult::EmptySpace; 
 
-		BSDF* bsdf = line.GetMaterialAtImpact()->SelectBSDF(line);
+		BSDF* bsdf = line.GetMaterialAtImpact()->SelectBSDF(*this, line);
 		PathSegment next;
 
 		if(outBsdf != nullptr)
 			*outBsdf = bsdf;
 
+		stats.bsdfEvaluations[EBsdfEvaluation::TransmitCamera]++;
+
 		if(bsdf->TransmitCamera(*this, line, &next))
 		{
 			line.Bounce();
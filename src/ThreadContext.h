@@ -30,6 +30,68 @@ enum class ETransmissionResult
 	NotAlive,
 };
 
+/*
+	What a ray is cast for, only used to break down statistics.
+*/
+namespace ERayKind
+{
+	enum
+	{
+		/** From the camera, including camera paths followed through caustic BSDFs. */
+		Primary,
+		/** Towards a light source, to decide about direct illumination. */
+		Shadow,
+		/** Through transmissive materials, while estimating indirect illumination. */
+		Indirect,
+		/** Emitted or bounced photons while filling the photon maps. */
+		Photon,
+
+		Count,
+	};
+}
+
+namespace EBsdfEvaluation
+{
+	enum
+	{
+		Surface,
+		DirectIllumination,
+		LocalIllumination,
+		TransmitPhoton,
+		TransmitCamera,
+
+		Count,
+	};
+}
+
+/*
+	Per-thread work counters, plain increments on the hot paths. Only the owning thread
+	writes them, RayTracer merges and resets them at the end of each stage.
+*/
+struct ThreadStats
+{
+	int64_t rays[ERayKind::Count];
+	int64_t rayHits;
+	int64_t rayMisses;
+	int64_t photonQueries;
+	int64_t photonsVisited;
+	int64_t bsdfEvaluations[EBsdfEvaluation::Count];
+	int64_t pixels;
+	int64_t directPasses;
+	int64_t indirectPasses;
+	int64_t transmissiveWalks;
+	int64_t transmissiveLayers;
+
+	ThreadStats() { Reset(); }
+
+	void Reset();
+
+	int64_t GetRaysCast() const { return rayHits + rayMisses; }
+
+	ThreadStats& operator+=(const ThreadStats& rhs);
+
+	void WriteJSON(std::ostream& out, std::string indent) const;
+};
 
 class ThreadContext
 {
@@ -48,11 +110,24 @@ private:
 	ThreadContext& operator=(const ThreadContext& rhs);
 public:
 
-	std::vector<int> forbiddenTriangles;
 	PhotonMapSearch samples;
+	std::vector<PhotonMapSearch> batchSamples; // results of batched searches, only ever grows
+	RandomGenerator random; // reseeded per unit of work, see ERandomStream
+	std::shared_ptr<Sampler> sampler; // restarted per pixel, see ESampleDimension
+	ThreadStats stats;
 	std::shared_ptr<RayIntersector> intersector;
 	std::vector<std::pair<PathSegment, PathSegment>> transmissions, transmissionsSwap;
 	std::vector<PathSegment> msaaSamples;
+	std::vector<PathSegment> primaryRays;
+	std::vector<PathSegment> indirectRays;
+	std::vector<std::pair<uint64_t, int>> rayStreamOrder;
+	std::vector<PathSegment> rayStreamBuffer;
+	std::vector<std::pair<uint32_t, int>> photonQueryOrder;
+	std::vector<Vector3> photonQueryPoints;
+	std::vector<PhotonMapSearch*> photonQueryResults;
+	std::vector<Vector3> estimatePoints;
+	std::vector<int> estimateTargets;
+	std::vector<Pixel> indirectEstimates;
 	std::vector<BSDFMaterial*> msaaMaterials;
 	std::vector<MSAACluster> msaaClusters;
 	std::vector<WeightedPixel> pixels;
@@ -64,7 +139,33 @@ public:
 	std::shared_ptr<std::vector<std::shared_ptr<MultiplicativeBSDFEntry>>> AllocateBsdfGroup();
 	void ResetBSDFGroups();
 
-	bool CastRay(const PathSegment& incoming, PathSegment& outgoing);
+	bool CastRay(const PathSegment& incoming, PathSegment& outgoing, int rayKind);
+
+	/** Packet version of CastRay() for segments that start in empty space or on the triangle at their origin. */
+	int CastRays(PathSegment* segments, int count, int rayKind);
+
+	/*
+		CastRays() for incoherent segments, e.g. hemisphere samples. The segments are traced in the
+		order of their direction octant and the Morton code of their origin, so consecutive packets
+		share most of their BVH nodes. Results are written back in place, returns the number of hits.
+	*/
+	int CastRayStream(PathSegment* segments, int count, int rayKind);
+
+	/*
+		Occlusion query from surface point "from" on "fromTriangle" (if any) to surface point "to", stopping 
+		at the first blocker. The triangle at "from" is ignored, as is everything within "tolerance" in front of "to".
+	*/
+	bool IsSegmentVisible(Vector3 from, const Triangle* fromTriangle, Vector3 to, int rayKind, float tolerance = 0);
+
+	/** kNN query on "map", results are stored in "samples". */
+	void SamplePhotons(PhotonMap& map, Vector3 where, int sampleCount);
+
+	/*
+		kNN queries for "count" points on "map", the results for "where[i]" are stored in "batchSamples[i]".
+		The queries are searched in the Morton order of their points, so nearby ones walk the tree together.
+	*/
+	void SamplePhotons(PhotonMap& map, const Vector3* where, int count, int sampleCount);
+
 	void ResetMSAAClusters();
 	const RenderSettings& GetSettings() const;
 	int GetThreadIndex() const { return threadIndex; }
@@ -89,6 +190,6 @@ public:
 		return res;
 	}
 	bool FollowTransmissive(PathSegment& view, Pixel* addToColor, BSDF** outBsdf = nullptr);
-	ETransmissionResult FollowTransmissiveEx(PathSegment& view, BSDF** outBsdf = nullptr, bool onStraightLine = false);
+	ETransmissionResult FollowTransmissiveEx(PathSegment& view, BSDF** outBsdf = nullptr, bool onStraightLine = false, int rayKind = ERayKind::Indirect);
 	ETransmissionResult FollowTransmissiveLine(PathSegment& line, BSDF** outBsdf = nullptr) { return FollowTransmissiveEx(line, outBsdf, true); }
 };
@@ -18,12 +18,12 @@
 #include "stdafx.h"
 
 const Mesh* Triangle::GetMesh() const { return mesh; }
-Vector3 Triangle::GetPointA() const { return mesh->vertices[a].position; }
-Vector3 Triangle::GetPointB() const { return mesh->vertices[b].position; }
-Vector3 Triangle::GetPointC() const { return mesh->vertices[c].position; }
-Vector3 Triangle::GetTexCoordA() const { return mesh->vertices[a].matUv; }
-Vector3 Triangle::GetTexCoordB() const { return mesh->vertices[b].matUv; }
-Vector3 Triangle::GetTexCoordC() const { return mesh->vertices[c].matUv; }
+Vector3 Triangle::GetPointA() const { return mesh->GetVertexPosition(a); }
+Vector3 Triangle::GetPointB() const { return mesh->GetVertexPosition(b); }
+Vector3 Triangle::GetPointC() const { return mesh->GetVertexPosition(c); }
+Vector3 Triangle::GetTexCoordA() const { return mesh->GetVertexTexCoord(a); }
+Vector3 Triangle::GetTexCoordB() const { return mesh->GetVertexTexCoord(b); }
+Vector3 Triangle::GetTexCoordC() const { return mesh->GetVertexTexCoord(c); }
 int Triangle::GetFaceIndex() const { return index; }
 
 float Triangle::GetArea() const
@@ -33,10 +33,10 @@ float Triangle::GetArea() const
 
 bool Triangle::HasHitBackface(Vector3 worldNormal) const 
 { 
-	return (worldNormal ^ mesh->vertices[a].normal) > 0; 
+	return (worldNormal ^ mesh->GetVertexNormal(a)) > 0; 
 }
 
-Vector3 Triangle::GetRandomPoint() const
+Vector3 Triangle::GetRandomBarycentrics(RandomGenerator& random) const
 {
 	/*
 		Uniform random distribution on triangle's surface.
@@ -44,9 +44,38 @@ Vector3 Triangle::GetRandomPoint() const
 			Chapter: Shape Distributions (page 814)
 	*/
 
-	float r1 = std::sqrtf(Math::GetRandomUnitFloat());
-	float r2 = Math::GetRandomUnitFloat();
-	return GetPointA() * (1 - r1) + GetPointB() * r1 * (1 - r2) + GetPointC() * r1 * r2;
+	float r[2];
+	random.NextFloats(r, 2);
+
+	float r1 = std::sqrtf(r[0]);
+	float r2 = r[1];
+	return Vector3(r1 * (1 - r2), r1 * r2, 0);
+}
+
+Vector3 Triangle::GetPoint(float u, float v) const
+{
+	return GetPointA() * (1 - u - v) + GetPointB() * u + GetPointC() * v;
+}
+
+Vector3 Triangle::GetTexCoord(float u, float v) const
+{
+	return GetTexCoordA() * (1 - u - v) + GetTexCoordB() * u + GetTexCoordC() * v;
+}
+
+Vector3 Triangle::GetBarycentrics(const Vector3& where) const
+{
+	/*
+		Solves where - A = u * (B - A) + v * (C - A) in the plane of the triangle.
+		Source: Christer Ericson, Real-Time Collision Detection (chapter 3.4)
+	*/
+	const Vector3 a = GetPointA(), e1 = GetPointB() - a, e2 = GetPointC() - a, p = where - a;
+	const float d11 = e1 ^ e1, d12 = e1 ^ e2, d22 = e2 ^ e2, dp1 = p ^ e1, dp2 = p ^ e2;
+	const float denom = d11 * d22 - d12 * d12;
+
+	if(denom == 0)
+		return Vector3(1 / 3.0f, 1 / 3.0f, 0); // degenerated triangle
+
+	return Vector3((d22 * dp1 - d12 * dp2) / denom, (d11 * dp2 - d12 * dp1) / denom, 0);
 }
 
 Triangle::Triangle(Mesh* mesh, int vertexA, int vertexB, int vertexC) 
@@ -149,30 +178,21 @@ Matrix3x3 Triangle::ComputeWorldToUvMatrix() const
 	);
  }
 
-float GetTriangleArea(Vector3 a, Vector3 b, Vector3 c)
-{
-	return 0.5f * Math::Length(Math::Cross(c - a, c - b));
-}
-
-Vector3 Triangle::GetNormal(const Vector3& where) const
+Vector3 Triangle::GetNormal(float u, float v) const
 {
-	// barycentric interpolation based on geometry data
-	const Vector3 x1 = GetPointA(), x2 = GetPointB(), x3 = GetPointC(), p = where;
-	const float A1 = GetTriangleArea(x2, p, x3), A2 = GetTriangleArea(x3, p, x1), A3 = GetTriangleArea(x1, p, x2);
-
 	Vector3 N = Math::Normalized(
-		(A1 * mesh->vertices[a].normal + 
-		A2 * mesh->vertices[b].normal + 
-		A3 * mesh->vertices[c].normal) / GetArea());
+		(1 - u - v) * mesh->GetVertexNormal(a) + 
+		u * mesh->GetVertexNormal(b) + 
+		v * mesh->GetVertexNormal(c));
 
 	// apply optional bump mapping
 	auto material = GetMesh()->GetMaterial();
 
-	if(material->GetBumpTexture() && (material->GetName().compare("vcWatr") == 0))
+	if(material->IsBumpMapped())
 	{
 		// perturbate normal
 		const TextureMap& bumpMap = *material->GetBumpTexture();
-		Pixel texNp = bumpMap.Interpolated(*this, where);
+		Pixel texNp = bumpMap.Interpolated(GetTexCoord(u, v));
 		Vector3 texN = (Vector3(texNp.r * 2 - 1, texNp.g * 2 - 1, texNp.b * 2 - 1) + Vector3(0,0,1)) / 2;
 
 		auto rot = Vectormath::Aos::Quat::rotation(Vectormath::Aos::Vector3(0,0,1), Math::Convert(N));
@@ -182,9 +202,19 @@ Vector3 Triangle::GetNormal(const Vector3& where) const
 	return N;
 }
 
+Vector3 Triangle::GetNormal(const Vector3& where) const
+{
+	const Vector3 uv = GetBarycentrics(where);
+
+	return GetNormal(uv.x, uv.y);
+}
+
 Vector3 Triangle::GetNormal(const PathSegment& incoming) const
 {
-	Vector3 normal = GetNormal(incoming.GetImpact());
+	// hits reported by the intersector carry their barycentrics, everything else is located by position
+	Vector3 normal = ((incoming.GetTriangleAtImpact() == this) && incoming.HasBarycentrics())
+		? GetNormal(incoming.GetImpactU(), incoming.GetImpactV())
+		: GetNormal(incoming.GetImpact());
 
 	// Flip normal if on opposite site of impact!
 
@@ -78,7 +78,9 @@ public:
 
 	TUVEntry& operator()(const PathSegment& segment)
 	{
-		return operator()(*segment.GetTriangleAtImpact(), segment.GetImpact());
+		Vector3 uv = segment.GetTexCoordAtImpact();
+
+		return operator()(uv.x, uv.y);
 	}
 
 	TUVEntry& operator()(const Triangle& triangle, Vector3 hitPoint)
@@ -145,7 +147,7 @@ public:
 		entries = std::vector<TUVEntry>(width * height);
 	}
 
-	Vector3 MakeUV(const PathSegment& segment) const { return MakeUV(*segment.GetTriangleAtImpact(), segment.GetImpact()); }
+	Vector3 MakeUV(const PathSegment& segment) const { return segment.GetTexCoordAtImpact(); }
 	Vector3 MakeUV(const Triangle& triangle, Vector3 hitPoint) const { return triangle.WorldToUv(hitPoint); }
 	Vector3 UVToOffset(Vector3 uv) const
 	{ 
@@ -45,9 +45,8 @@ std::shared_ptr<UnifiedProperty> UnifiedProperty::DeserializeFormat(BinaryReader
 	return res;
 }
 
-void RunTest_UnifiedSettings()
+std::shared_ptr<UnifiedSettings> CreateSettingsFormat()
 {
-	// create test specification
 	auto settingsFormat = std::make_shared<UnifiedSettings>("Raylice Settings");
 
 	auto matFormat = settingsFormat->AddChildFormat("Material", "A BSDF material.");
@@ -116,6 +115,14 @@ void RunTest_UnifiedSettings()
 		cameraFormat->AddVector3Property("RectSize");	
 	}
 
+	return settingsFormat;
+}
+
+void RunTest_UnifiedSettings()
+{
+	// create test specification
+	auto settingsFormat = CreateSettingsFormat();
+
 	std::ofstream cfgFormat("./config.format.raylice", std::ios_base::trunc | std::ios::binary);
 	settingsFormat->SerializeFormat(BinaryWriter(cfgFormat));
 }
\ No newline at end of file
@@ -891,5 +891,10 @@ public:
 
 };
 
+/*
+	The settings format shared with the Unity exporter (see "config.format.raylice"). Scenes
+	created in code (SyntheticScene) instantiate their materials and cameras from it.
+*/
+extern std::shared_ptr<UnifiedSettings> CreateSettingsFormat();
 extern void RunTest_UnifiedSettings();
 
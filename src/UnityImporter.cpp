@@ -63,24 +63,27 @@ void UnityImporter::ReadSync()
 
 std::shared_ptr<Mesh> Mesh::Instanciate(Matrix4x4 transform, std::shared_ptr<UnifiedSettings> material)
 {
-	auto instance = std::make_shared<Mesh>();
+	// instances of instances share the vertices of the original prototype
+	if(prototype)
+		return prototype->Instanciate(transform * this->transform, material);
 
-	instance->vertices = vertices;
+	auto instance = std::make_shared<Mesh>();
 
-	for(int i = 0; i < instance->vertices.size(); i++)
-	{
-		auto& v = instance->vertices[i];
-		v.normal = Math::TransformDirection(transform, vertices[i].normal);
-		v.position = Math::TransformVector(transform, vertices[i].position);
-	}
+	instance->prototype = shared_from_this();
+	instance->transform = transform;
 
 	instance->triangles.reserve(triangles.size());
-	for (int i = 0, j = 0; i < triangles.size(); i++, j +=3)
+	for (const auto& tri : triangles)
     {
-		instance->triangles.push_back(Triangle(instance.get(), j, j + 1, j + 2));
+		instance->triangles.push_back(Triangle(instance.get(), tri.a, tri.b, tri.c));
 	}
 
-	instance->material = BSDFMaterial::FromTemplate(material);
+	auto& sharedMaterial = instanceMaterials[material.get()];
+
+	if(!sharedMaterial)
+		sharedMaterial = BSDFMaterial::FromTemplate(material);
+
+	instance->material = sharedMaterial;
 	instance->light = LightSource::TryFromTemplate(material, instance);
 
 	return instance;
@@ -164,42 +167,72 @@ std::shared_ptr<Mesh> UnityImporter::DeserializeTriangles(int64_t fileOffset)
     int triangleCount = reader.ReadInt32() / 3;
     bool hasUVs = reader.ReadBoolean();
 	
-	mesh->vertices.reserve(triangleCount * 3);
-	triangleBuffer.resize(triangleCount * 3 * (hasUVs ? 8 : 6));
+	const int stride = hasUVs ? 8 : 6;
+	triangleBuffer.resize(triangleCount * 3 * stride);
 
 	reader.ReadSingleArray(triangleBuffer, triangleBuffer.size());
 
 	if(0x76FA0B62 != reader.ReadInt32())
 		throw std::invalid_argument("Stream is out of sync.");
 
-    for (int i = 0, j = 0; i < triangleCount * 3; i++)
-    {
+	/*
+		Unity serializes every triangle with three vertices of its own. Corners with bitwise identical
+		attributes are welded into one vertex, so triangles index a shared pool. The open addressing
+		table maps to the first corner with a given record, "vertexIndices" to its index in the pool.
+	*/
+	const int cornerCount = triangleCount * 3;
+	int tableSize = 1;
+
+	while(tableSize < 2 * cornerCount)
+		tableSize *= 2;
+
+	vertexTable.assign(tableSize, -1);
+	vertexIndices.resize(cornerCount);
+	mesh->vertices.reserve(cornerCount);
+
+	for(int i = 0; i < cornerCount; i++)
+	{
+		const uint32_t* record = (const uint32_t*)&triangleBuffer[i * stride];
+		uint64_t hash = 14695981039346656037ULL;
+
+		for(int k = 0; k < stride; k++)
+		{
+			hash = (hash ^ record[k]) * 1099511628211ULL;
+		}
+
+		int slot = (int)(hash & (tableSize - 1));
+
+		while((vertexTable[slot] >= 0) && (memcmp(&triangleBuffer[vertexTable[slot] * stride], record, stride * sizeof(float)) != 0))
+		{
+			slot = (slot + 1) & (tableSize - 1);
+		}
+
+		if(vertexTable[slot] >= 0)
+		{
+			vertexIndices[i] = vertexIndices[vertexTable[slot]];
+			continue;
+		}
+
+		const float* values = &triangleBuffer[i * stride];
 		Vertex v;
 
-        float x = triangleBuffer[j++];
-        float y = triangleBuffer[j++];
-        float z = triangleBuffer[j++];
-		v.position = Vector3(x, y, z);
+		v.position = Vector3(values[0], values[1], values[2]);
+		v.normal = Vector3(values[3], values[4], values[5]);
 
-        x = triangleBuffer[j++];
-        y = triangleBuffer[j++];
-        z = triangleBuffer[j++];
-		v.normal = Vector3(x, y, z);
+		if (hasUVs)
+			v.matUv = Vector3(values[6], values[7], 0);
 
-        if (hasUVs)
-        {
-            x = triangleBuffer[j++];
-            y = triangleBuffer[j++];
-			v.matUv = Vector3(x, y, 0);
-        }
-		
+		vertexTable[slot] = i;
+		vertexIndices[i] = (int)mesh->vertices.size();
 		mesh->vertices.push_back(v);
-    }
+	}
+
+	mesh->vertices.shrink_to_fit();
 
 	mesh->triangles.reserve(triangleCount);
 	for (int i = 0, j = 0; i < triangleCount; i++, j +=3)
     {
-		mesh->triangles.push_back(Triangle(mesh.get(), j, j + 1, j + 2));
+		mesh->triangles.push_back(Triangle(mesh.get(), vertexIndices[j], vertexIndices[j + 1], vertexIndices[j + 2]));
 	}
 
 	stream.seekg(oldPosition, std::ios_base::beg);
@@ -24,6 +24,7 @@ private:
 
 	std::shared_ptr<UnifiedSettings> settings;
 	std::vector<float> triangleBuffer;
+	std::vector<int> vertexTable, vertexIndices;
 	std::unordered_map<int64_t, std::shared_ptr<TextureMap>> texIdToTex;
 	std::vector<unsigned char> textureBuffer;
 	std::unordered_map<int64_t, std::shared_ptr<Mesh>> meshIdToMesh;
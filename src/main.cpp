@@ -43,12 +43,20 @@ int processCommandLine(int argc, char** argv, RenderSettings& outSettings)
 		("indirect-smoothing-samples", po::value<int>(), "Randomly select one nearest photon out of %ARG% many neighboring photons for indirect illumination estimation. (defaults to 1-8 depedening on quality level)")
 		("indirect-light-amplifier", po::value<float>(), "Multiplicator for direct lighting used to estimate indirect lighting. Default is 2, higher values make shadow regions brighter.")
 		("indirect-light-tolerance", po::value<float>(), "How close must a mutated light ray hit be to the current estimation point to be considered a light-hit? Default is 0.0001! Other values may be needed to accomodate strange model dimensions (precision issues).")
+		("sampler", po::value<std::string>(), "Sample point generator for MSAA positions, indirect hemisphere directions and BSDF selection. Valid values are \"sobol\", \"halton\" and \"random\", default is \"sobol\". Powers of two for MSAA and sub-samples work best with \"sobol\".")
+		("accel", po::value<std::string>(), "Acceleration structure for ray casting. Valid values are \"bvh2\", \"bvh4\" (object split builders), \"bvh2.spatialsplit\", \"bvh4.spatialsplit\" (more memory, faster traversal for scenes with large overlapping triangles), \"bvh4mb\" and \"bvh4c\" (quantized nodes and shared vertices, about half the memory of \"bvh4\" at slower traversal), default is \"bvh4\".")
+		("triangle-layout", po::value<std::string>(), "Triangle storage of the acceleration structure, optionally followed by the intersector, e.g. \"triangle4v.pluecker\". Valid layouts are \"triangle1\", \"triangle1i\", \"triangle1v\", \"triangle4\", \"triangle4i\", \"triangle4v\" and \"triangle8\" (AVX builds only); intersectors are \"moeller\" and \"pluecker\" (\"v\" and \"i\" layouts only). Default is \"triangle4\" (\"triangle8\" with AVX).")
+		("photon-lookup", po::value<std::string>(), "Spatial index for photon gathering. Valid values are \"kdtree\" (exact nearest photons) and \"grid\" (nearest photons within a fixed radius derived from the photon density, faster for many photons per query), default is \"kdtree\".")
 		("resolution,r", po::value<int>(), "Resolution in pixels of the final image (longest side, depending on aspect ratio of the scene's camera). Default is 1024.")
 		("debug", po::value<std::string>(), "Outputs various debug files. Multiple values can be passed separated by a comma. Valid values are 'indirect', 'direct', 'estimate', 'local' and 'all'.")
-		("perfmon", po::value<std::string>(), "Outputs various performance monitoring files. Multiple values can be passed separated by a comma. Valid values are 'indirect', 'direct', 'total' and 'all'.")
+		("perfmon", po::value<std::string>(), "Outputs per-pixel performance data as raw float layers of one EXR file, next to the output file. Multiple values can be passed separated by a comma. Valid values are 'indirect', 'direct', 'total' (nanoseconds spent), 'counts' (adaptive passes, rays and kNN queries) and 'all'.")
 		("output-file,o", po::value<std::string>(), "The image file to be generated. Only OpenEXR file format is supported! Default value is input file followed by \".exr\".")
 		("input-file,i", po::value<std::string>(), "A scene file to be rendered. This is the only required parameter!")
+		("synthetic", po::value<std::string>(), "Generates a scene instead of loading \"input-file\". Comma separated list, starting with the variant \"cornell\", \"empty\" or \"open\", followed by any of \"instances=N\", \"triangles=N\" (total, e.g. 1e6), \"emissive=N\", \"glass=N\" (glass panes), \"clutter=N\" and \"seed=N\". Example: \"cornell,instances=64,triangles=1e7,emissive=16\".")
 		("no-preview", "Don't show a preview window during rendering.")
+		("no-bvh-cache", "Always build the acceleration structure. By default it is stored next to the input file (\"<input-file>.<N>.bvhcache\") and loaded from there as long as geometry, \"accel\" and \"triangle-layout\" are unchanged. Only \"bvh4\" and \"bvh4c\" are cached.")
+		("stats-json", po::value<std::string>(), "Writes counters for rays, hits, kNN queries, BSDF evaluations, adaptive passes and transmissive layers, per rendering stage, to the given JSON file.")
+		("benchmark", po::value<std::string>(), "Instead of rendering an image, runs all stages with 1, 2, 4, ... up to \"thread-count\" threads and writes timings, throughput and parallel efficiency per stage to the given JSON file.")
 	;
 
 	// parse command line
@@ -87,9 +95,16 @@ int processCommandLine(int argc, char** argv, RenderSettings& outSettings)
 	if (vm.count("thread-count")) outSettings.threadCount = vm["thread-count"].as<int>();
 	if (vm.count("indirect-light-amplifier")) outSettings.indirectLightAmplifier = vm["indirect-light-amplifier"].as<float>();
 	if (vm.count("indirect-light-tolerance")) outSettings.indirectLightTolerance = vm["indirect-light-tolerance"].as<float>();
+	if (vm.count("sampler")) outSettings.sampler = vm["sampler"].as<std::string>();
+	if (vm.count("accel")) outSettings.accel = vm["accel"].as<std::string>();
+	if (vm.count("photon-lookup")) outSettings.photonLookup = vm["photon-lookup"].as<std::string>();
+	if (vm.count("triangle-layout")) outSettings.triangleLayout = vm["triangle-layout"].as<std::string>();
 	if (vm.count("resolution")) outSettings.resolution = vm["resolution"].as<int>();
 	if (vm.count("output-file")) outSettings.outputFile = vm["output-file"].as<std::string>();
 	if (vm.count("input-file")) outSettings.inputFile = vm["input-file"].as<std::string>();
+	if (vm.count("synthetic")) outSettings.syntheticScene = vm["synthetic"].as<std::string>();
+	if (vm.count("stats-json")) outSettings.statsFile = vm["stats-json"].as<std::string>();
+	if (vm.count("benchmark")) outSettings.benchmarkFile = vm["benchmark"].as<std::string>();
 	
 	if (vm.count("perfmon"))
 	{
@@ -103,6 +118,7 @@ int processCommandLine(int argc, char** argv, RenderSettings& outSettings)
 			if((e == "direct") || (e == "all")) flag |= EPixelPerfMon::Direct;
 			if((e == "indirect") || (e == "all")) flag |= EPixelPerfMon::Indirect;
 			if((e == "total") || (e == "all")) flag |= EPixelPerfMon::Total;
+			if((e == "counts") || (e == "all")) flag |= EPixelPerfMon::Counts;
 			
 			if(flag == 0)
 				std::cerr << "[WARNING]: Invalid perfmon flag \"" << e << "\" (ignored)." << std::endl;
@@ -135,6 +151,7 @@ int processCommandLine(int argc, char** argv, RenderSettings& outSettings)
 	if (vm.count("input-file")) outSettings.inputFile = vm["input-file"].as<std::string>();
 
 	outSettings.noPreview = vm.count("no-preview");
+	outSettings.noBvhCache = vm.count("no-bvh-cache");
 
 	// validate and correct mistakes if possible
 	if(!outSettings.MakeValid())
@@ -157,9 +174,20 @@ int processCommandLine(int argc, char** argv, RenderSettings& outSettings)
 	std::cout << "    > Shadow-Samples = " << outSettings.shadowSamples << std::endl;
 	std::cout << "    > Shadow-Sample-Factor = " << outSettings.shadowSampleFactor << std::endl;
 	std::cout << "    > Resolution = " << outSettings.resolution << std::endl;
+	std::cout << "    > Sampler = " << outSettings.sampler << std::endl;
+	std::cout << "    > Acceleration structure = " << outSettings.accel << " (" << outSettings.triangleLayout << " triangles)" << std::endl;
+	std::cout << "    > Photon lookup = " << outSettings.photonLookup << std::endl;
 	std::cout << "    > Thread count = " << outSettings.threadCount << std::endl;
-	std::cout << "    > Input file = \"" << outSettings.inputFile << "\"" << std::endl;
-	std::cout << "    > Output file = \"" << outSettings.outputFile << "\"" << std::endl << std::endl;
+	if(outSettings.syntheticScene.empty())
+		std::cout << "    > Input file = \"" << outSettings.inputFile << "\"" << std::endl;
+	else
+		std::cout << "    > Synthetic scene = \"" << outSettings.syntheticScene << "\"" << std::endl;
+	std::cout << "    > Output file = \"" << outSettings.outputFile << "\"" << std::endl;
+
+	if(!outSettings.benchmarkFile.empty())
+		std::cout << "    > Benchmark file = \"" << outSettings.benchmarkFile << "\"" << std::endl;
+
+	std::cout << std::endl;
 	
 	return 0;
 }
@@ -174,8 +202,20 @@ int main(int argc, char** argv)
 	if((result = processCommandLine(argc, argv, settings)) != 0)
 		return result;
 
+	if(!settings.benchmarkFile.empty())
+	{
+		StageBenchmark benchmark(settings);
+		benchmark.Run();
+
+		std::ofstream file(settings.benchmarkFile, std::ios_base::trunc);
+		benchmark.WriteJSON(file);
+
+		std::cout << ">> Benchmark results have been saved to disk!" << std::endl;
+		return EXIT_SUCCESS;
+	}
+
 	StopWatch watch;
-	std::shared_ptr<UnityImporter> scene;
+	std::shared_ptr<Scene> scene;
 
 	std::cout << "Loading scene...";
 
@@ -183,12 +223,12 @@ int main(int argc, char** argv)
 	try
 	{
 #endif
-		scene = std::make_shared<UnityImporter>(settings.inputFile);
+		scene = Scene::FromSettings(settings);
 #ifndef _DEBUG
 	}
 	catch(const std::exception& e)
 	{
-		std::cerr << "[ERROR]: Could not load scene file. Make sure file exists!" << std::endl;
+		std::cerr << "[ERROR]: Could not load scene file. Make sure file exists and synthetic scene options are valid!" << std::endl;
 		std::cerr << " > Details: " << e.what() << std::endl;
 		return -1;
 	}
@@ -201,6 +241,9 @@ int main(int argc, char** argv)
 	RayTracer rayTracer(scene, settings);
 
 	std::cout << " [DONE, " << watch << "]" << std::endl;
+	std::cout << "    > Acceleration structure built in " << (rayTracer.GetBVHBuildSeconds() * 1000) << " ms (" 
+		<< (rayTracer.GetBVHPrepareSeconds() * 1000) << " ms preparing triangles, " << rayTracer.GetBVHCachedAccelCount() << " of " << rayTracer.GetBVHAccelCount() << " accels loaded from cache) on " << rayTracer.GetThreadCount() << " threads, " 
+		<< (rayTracer.GetBVHBytes() / 1E6) << " MB, " << (rayTracer.GetBVHRaysPerSecond() / 1E6) << " Mrays/s (primary rays, one thread)" << std::endl;
 	watch.Reset();
 	std::cout << "Tracing photons...";
 
@@ -221,5 +264,13 @@ int main(int argc, char** argv)
 	std::cout << " [DONE, " << watch << "]" << std::endl;
 	std::cout << ">> Image has been saved to disk!" << std::endl;
 
+	if(!settings.statsFile.empty())
+	{
+		std::ofstream file(settings.statsFile, std::ios_base::trunc);
+		rayTracer.WriteStatsJSON(file);
+
+		std::cout << ">> Statistics have been saved to disk!" << std::endl;
+	}
+
     return EXIT_SUCCESS;
 }
\ No newline at end of file